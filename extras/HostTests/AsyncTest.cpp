@@ -0,0 +1,264 @@
+// Runs queueAsync() requests against an emulated module.  Fails when
+// a blocking call made while a request is on the wire does not return
+// or gets the wrong reply, when requests go out of lane order, a
+// background query is not preempted, or a cancelled or timed out 
+// request does not complete from loop() with its status.
+//
+// AsyncTest
+//
+#define DfMiniMp3Async
+#include <Arduino.h>
+#include <stdio.h>
+#include <vector>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static unsigned s_failures = 0;
+static std::vector<uint8_t> s_completed;
+
+static void completed(DfMp3_AsyncRequest* request)
+{
+    s_completed.push_back(request->command);
+}
+
+// keeps the commands in the order they went on the wire
+class LogSerial : public Mp3HostSerial
+{
+public:
+    std::vector<uint8_t> sent;
+
+    size_t write(const uint8_t* data, size_t size)
+    {
+        if (size >= 8 && data[0] == Mp3_PacketStartCode)
+        {
+            sent.push_back(data[3]);
+        }
+        return Mp3HostSerial::write(data, size);
+    }
+};
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources)
+    {
+    }
+};
+
+typedef DFMiniMp3<LogSerial, Mp3Notify> DfMp3;
+
+static void check(bool isOk, const char* test, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", test, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+// loop() until nothing is queued or time is up
+static void run(DfMp3& mp3, uint32_t time)
+{
+    uint32_t started = millis();
+
+    while (!mp3.isAsyncIdle() && millis() - started < time)
+    {
+        mp3.loop();
+        Mp3HostAdvance(1000);
+    }
+}
+
+// a blocking query while an async one is on the wire waits for it
+static void mixed()
+{
+    const char* test = "mixed";
+    LogSerial serial;
+    DfMp3 mp3(serial);
+    DfMp3_AsyncRequest volume = {};
+    uint32_t started;
+
+    mp3.begin();
+    serial.volume = 17;
+    serial.status = 0x0201;
+    mp3.queueAsync<Mp3_Command_GetVolume>(&volume);
+    mp3.loop();
+    check(volume.status == DfMp3_AsyncStatus_Pending, test, "not on the wire", volume.status);
+
+    started = millis();
+    DfMp3_Status status = mp3.getStatus();
+    check(status.state == DfMp3_StatusState_Playing, test, "status", status.state);
+    check(millis() - started < 200, test, "blocking call took ms", millis() - started);
+
+    run(mp3, 5000);
+    check(volume.status == DfMp3_AsyncStatus_Done, test, "async not done", volume.status);
+    check(volume.result == 17, test, "async volume", volume.result);
+}
+
+static bool isSent(const LogSerial& serial, const uint8_t* commands, size_t count)
+{
+    if (serial.sent.size() != count)
+    {
+        return false;
+    }
+    for (size_t index = 0; index < count; index++)
+    {
+        if (serial.sent[index] != commands[index])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// queued together, they go out by lane and in order within one
+static void laneOrder()
+{
+    const char* test = "lane order";
+    LogSerial serial;
+    DfMp3 mp3(serial);
+    DfMp3_AsyncRequest requests[5] = {};
+    static const uint8_t c_expected[] = {
+        Mp3_Commands_Stop,
+        Mp3_Commands_SetVolume,
+        Mp3_Commands_SetEq,
+        Mp3_Commands_GetVolume,
+        Mp3_Commands_GetStatus };
+
+    mp3.begin();
+    serial.sent.clear();
+    s_completed.clear();
+    for (DfMp3_AsyncRequest& request : requests)
+    {
+        request.complete = completed;
+    }
+    mp3.queueAsync<Mp3_Command_GetVolume>(&requests[0]);
+    mp3.queueAsync<Mp3_Command_SetVolume>(&requests[1], 10);
+    mp3.queueAsync<Mp3_Command_GetStatus>(&requests[2]);
+    mp3.queueAsync<Mp3_Command_SetEq>(&requests[3], DfMp3_Eq_Rock);
+    mp3.queueAsync<Mp3_Command_Stop>(&requests[4]);
+    run(mp3, 10000);
+
+    check(isSent(serial, c_expected, sizeof(c_expected)), test, "wire order", serial.sent.size());
+    check(s_completed.size() == 5 && s_completed[0] == Mp3_Commands_Stop && 
+        s_completed[4] == Mp3_Commands_GetStatus, 
+        test, "completion order", s_completed.size());
+    for (const DfMp3_AsyncRequest& request : requests)
+    {
+        check(request.status == DfMp3_AsyncStatus_Done, test, "not done", request.command);
+    }
+    check(requests[0].result == 10, test, "volume read before it was set", requests[0].result);
+}
+
+// a background query whose reply is lost goes back behind a realtime
+// request queued meanwhile, rather than retrying first
+static void preemption()
+{
+    const char* test = "preemption";
+    LogSerial serial;
+    DfMp3 mp3(serial);
+    DfMp3_AsyncRequest query = {};
+    DfMp3_AsyncRequest stop = {};
+    static const uint8_t c_expected[] = {
+        Mp3_Commands_GetVolume,
+        Mp3_Commands_Stop,
+        Mp3_Commands_GetVolume };
+
+    mp3.begin();
+    serial.sent.clear();
+    serial.dropNext = 1;
+    mp3.queueAsync<Mp3_Command_GetVolume>(&query);
+    mp3.loop();
+    mp3.queueAsync<Mp3_Command_Stop>(&stop);
+    run(mp3, 10000);
+
+    check(isSent(serial, c_expected, sizeof(c_expected)), test, "wire order", serial.sent.size());
+    check(stop.status == DfMp3_AsyncStatus_Done, test, "stop not done", stop.status);
+    check(query.status == DfMp3_AsyncStatus_Done, test, "query not done", query.status);
+    check(query.result == 15, test, "volume", query.result);
+}
+
+// a lane cancelled completes its queued requests as cancelled, the
+// one on the wire is seen through
+static void cancel()
+{
+    const char* test = "cancel";
+    LogSerial serial;
+    DfMp3 mp3(serial);
+    DfMp3_AsyncRequest requests[4] = {};
+
+    mp3.begin();
+    serial.sent.clear();
+    s_completed.clear();
+    for (DfMp3_AsyncRequest& request : requests)
+    {
+        request.complete = completed;
+        mp3.queueAsync<Mp3_Command_GetVolume>(&request);
+    }
+    mp3.loop();
+
+    check(!mp3.cancelAsync(&requests[0]), test, "cancelled on the wire", requests[0].status);
+    check(mp3.cancelAsync(&requests[3]), test, "queued one not cancelled", requests[3].status);
+    check(requests[3].status == DfMp3_AsyncStatus_Idle, test, "cancelled one not idle", requests[3].status);
+    check(mp3.cancelAsync(DfMp3_AsyncLane_Background) == 2, test, "lane count", 0);
+    run(mp3, 10000);
+
+    check(serial.sent.size() == 1, test, "cancelled sent", serial.sent.size());
+    check(requests[0].status == DfMp3_AsyncStatus_Done, test, "first not done", requests[0].status);
+    check(requests[1].status == DfMp3_AsyncStatus_Cancelled && 
+        requests[2].status == DfMp3_AsyncStatus_Cancelled, 
+        test, "lane not cancelled", requests[1].status);
+    check(s_completed.size() == 3, test, "completions", s_completed.size());
+}
+
+// without an ack it is retried and fails with the timeout
+static void timeout()
+{
+    const char* test = "timeout";
+    LogSerial serial;
+    DfMp3 mp3(serial);
+    DfMp3_AsyncRequest request = {};
+    uint32_t started;
+
+    mp3.begin();
+    serial.sent.clear();
+    serial.isAcking = false;
+    s_completed.clear();
+    request.complete = completed;
+    mp3.queueAsync<Mp3_Command_SetVolume>(&request, 5);
+    started = millis();
+    run(mp3, 10000);
+
+    check(request.status == DfMp3_AsyncStatus_Failed, test, "not failed", request.status);
+    check(request.result == DfMp3_Error_RxTimeout, test, "result", request.result);
+    check(serial.sent.size() == 3, test, "sends", serial.sent.size());
+    check(s_completed.size() == 1, test, "completions", s_completed.size());
+    check(millis() - started >= 3 * 900, test, "failed early", millis() - started);
+}
+
+int main()
+{
+    mixed();
+    laneOrder();
+    preemption();
+    cancel();
+    timeout();
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
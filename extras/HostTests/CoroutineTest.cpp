@@ -0,0 +1,107 @@
+// Runs a Mp3Coroutine.h flow against an emulated module, with a
+// blocking call made while one of its commands is on the wire.  Fails
+// when the flow does not run to its end or an awaited reply is wrong.
+//
+// CoroutineTest, built as C++20
+//
+#define DfMiniMp3Async
+#include <Arduino.h>
+#include <stdio.h>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+#include "Mp3Coroutine.h"
+
+static unsigned s_failures = 0;
+static Mp3CoSignal s_finished;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t)
+    {
+        s_finished.set();
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources)
+    {
+    }
+};
+
+typedef DFMiniMp3<Mp3HostSerial, Mp3Notify> DfMp3;
+
+static void check(bool isOk, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL flow: %s (%u)\n", what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+struct flow_t
+{
+    uint16_t count;
+    bool isPlayed;
+    DfMp3_Status status;
+    bool isDone;
+};
+
+static Mp3Task playOne(Mp3CoDevice<DfMp3>& device, flow_t* flow)
+{
+    flow->count = co_await device.getFolderTrackCount(1);
+    flow->isPlayed = co_await device.playFolderTrack(1, flow->count);
+    co_await s_finished;
+    flow->status = co_await device.getStatus();
+    flow->isDone = true;
+}
+
+int main()
+{
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    Mp3CoDevice<DfMp3> device(mp3);
+    flow_t flow = {};
+    bool isFinishing = false;
+
+    mp3.begin();
+    serial.queryReply = 12;
+    serial.status = 0x0200;
+    serial.volume = 21;
+
+    playOne(device, &flow);
+    mp3.loop();
+    // the folder count is on the wire, this waits for it
+    check(mp3.getVolume() == 21, "blocking volume", 0);
+
+    for (uint32_t started = millis(); !flow.isDone && millis() - started < 10000; )
+    {
+        if (!isFinishing && serial.commands[Mp3_Commands_PlayFolderTrack])
+        {
+            serial.inject(Mp3_Replies_TrackFinished_Sd, 12, 500000);
+            isFinishing = true;
+        }
+        mp3.loop();
+        Mp3HostAdvance(1000);
+    }
+
+    check(flow.isDone, "not done", 0);
+    check(flow.count == 12, "folder track count", flow.count);
+    check(flow.isPlayed, "play not acked", 0);
+    check(flow.status.state == DfMp3_StatusState_Idle, "status", flow.status.state);
+    check(mp3.isAsyncIdle(), "requests left", 0);
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
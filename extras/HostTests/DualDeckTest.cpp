@@ -0,0 +1,222 @@
+// Crossfades a playlist across two emulated modules with Mp3DualDeck.
+// Fails when the decks do not take turns, a clip is not started
+// once and in order, a volume above the one set is sent, also when
+// it is lowered in the middle of a fade, or the playlist does not
+// end with both modules stopped.
+//
+// DualDeckTest
+//
+#include <Arduino.h>
+#include <stdio.h>
+#include <vector>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static unsigned s_failures = 0;
+
+// ms each sd:/mp3/#### track plays for, the playlist is 1 to 4
+static const uint32_t s_durations[] = { 0, 10000, 8000, 12000, 9000 };
+static const uint16_t c_TrackCount = 4;
+
+// a module that plays what it is told, reporting the track finished
+// once its duration has passed unpaused
+class DeckSerial : public Mp3HostSerial
+{
+public:
+    DeckSerial() :
+        track(0),
+        isPaused(false),
+        volumeMax(0),
+        _remaining(0),
+        _ticked(0)
+    {
+    }
+
+    uint16_t track; // playing or paused, zero when stopped
+    bool isPaused;
+    uint16_t volumeMax; // the highest volume set
+    std::vector<uint16_t> started; // tracks asked to play
+
+    size_t write(const uint8_t* data, size_t size)
+    {
+        if (size >= 8 && data[0] == Mp3_PacketStartCode)
+        {
+            command(data[3], (static_cast<uint16_t>(data[5]) << 8) | data[6]);
+        }
+        return Mp3HostSerial::write(data, size);
+    }
+
+    // plays for the time passed since the last call
+    void tick()
+    {
+        uint64_t elapsed = Mp3HostMicros() - _ticked;
+
+        _ticked = Mp3HostMicros();
+        if (track == 0 || isPaused)
+        {
+            return;
+        }
+
+        if (_remaining <= elapsed)
+        {
+            inject(Mp3_Replies_TrackFinished_Sd, track, latency);
+            track = 0;
+        }
+        else
+        {
+            _remaining -= elapsed;
+        }
+    }
+
+private:
+    uint64_t _remaining; // micros of the track left to play
+    uint64_t _ticked;
+
+    void command(uint8_t command, uint16_t arg)
+    {
+        switch (command)
+        {
+        case Mp3_Commands_SetVolume:
+            if (arg > volumeMax)
+            {
+                volumeMax = arg;
+            }
+            break;
+
+        case Mp3_Commands_PlayMp3FolderTrack:
+            track = arg;
+            isPaused = false;
+            _remaining = static_cast<uint64_t>(s_durations[arg]) * 1000;
+            started.push_back(arg);
+            break;
+
+        case Mp3_Commands_Pause:
+            isPaused = true;
+            break;
+
+        case Mp3_Commands_Start:
+            isPaused = false;
+            break;
+
+        case Mp3_Commands_Stop:
+            track = 0;
+            break;
+        }
+    }
+};
+
+class Mp3Notify;
+typedef DFMiniMp3<DeckSerial, Mp3Notify> DfMp3;
+
+static Mp3DualDeck<DfMp3>* s_decks = nullptr;
+
+class Mp3Notify
+{
+public:
+    static void OnError(DfMp3&, uint16_t)
+    {
+    }
+
+    static void OnPlayFinished(DfMp3& mp3, DfMp3_PlaySources, uint16_t)
+    {
+        s_decks->onPlayFinished(mp3);
+    }
+
+    static void OnPlaySourceOnline(DfMp3&, DfMp3_PlaySources)
+    {
+    }
+
+    static void OnPlaySourceInserted(DfMp3&, DfMp3_PlaySources)
+    {
+    }
+
+    static void OnPlaySourceRemoved(DfMp3&, DfMp3_PlaySources)
+    {
+    }
+};
+
+static bool nextClip(DfMp3_Clip* clip, uint32_t* duration, void* context)
+{
+    uint16_t* next = static_cast<uint16_t*>(context);
+
+    if (*next > c_TrackCount)
+    {
+        return false;
+    }
+    clip->kind = DfMp3_ClipKind_Mp3;
+    clip->arg = *next;
+    *duration = s_durations[*next];
+    (*next)++;
+    return true;
+}
+
+static void check(bool isOk, const char* test, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", test, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+// plays the playlist at volume, lowered to lowVolume lowAt ms in
+// when that is not zero
+static void crossfade(const char* test, uint8_t volume, uint32_t lowAt, uint8_t lowVolume)
+{
+    DeckSerial serialA;
+    DeckSerial serialB;
+    DfMp3 deckA(serialA);
+    DfMp3 deckB(serialB);
+    uint16_t next = 1;
+    Mp3DualDeck<DfMp3> decks(deckA, deckB, nextClip, &next);
+    uint32_t started = millis();
+    uint32_t playedMax = 0;
+
+    s_decks = &decks;
+    deckA.begin();
+    deckB.begin();
+    decks.setVolume(volume);
+    decks.setCrossfadeTime(3000);
+    check(decks.start(), test, "not started", 0);
+
+    for (uint32_t elapsed = 0; decks.isPlaying() && elapsed < 60000; elapsed = millis() - started)
+    {
+        if (lowAt && elapsed >= lowAt)
+        {
+            decks.setVolume(lowVolume);
+            volume = lowVolume;
+            lowAt = 0;
+        }
+        serialA.tick();
+        serialB.tick();
+        deckA.loop();
+        deckB.loop();
+        decks.loop();
+        Mp3HostAdvance(1000);
+    }
+    playedMax = s_durations[1] + s_durations[2] + s_durations[3] + s_durations[4];
+
+    check(!decks.isPlaying(), test, "playlist did not end", millis() - started);
+    check(millis() - started < playedMax - 2 * 3000, test, "tracks did not overlap", millis() - started);
+    check(serialA.track == 0 && serialB.track == 0, test, "a deck was left playing", serialA.track | serialB.track);
+    check(serialA.started.size() == 2 && serialA.started[0] == 1 && serialA.started[1] == 3,
+        test, "deck A did not play 1 and 3", serialA.started.size());
+    check(serialB.started.size() == 2 && serialB.started[0] == 2 && serialB.started[1] == 4,
+        test, "deck B did not play 2 and 4", serialB.started.size());
+    check(serialA.volumeMax <= 30 && serialB.volumeMax <= 30,
+        test, "volume out of range", serialA.volumeMax > serialB.volumeMax ? serialA.volumeMax : serialB.volumeMax);
+    check(serialA.volume == volume || serialB.volume == volume,
+        test, "last deck not at the volume", volume);
+    s_decks = nullptr;
+}
+
+int main()
+{
+    crossfade("crossfade", 20, 0, 0);
+    // the fade of the first track runs from 7000ms to 10000ms
+    crossfade("lowered mid fade", 20, 8500, 5);
+    crossfade("raised mid fade", 10, 8500, 25);
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
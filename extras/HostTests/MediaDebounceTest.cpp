@@ -0,0 +1,148 @@
+// Bounces a card in and out within the DfMiniMp3MediaDebounce settle
+// time.  Fails when a report other than the settled change from what
+// was last notified gets through, or the held ones are not counted
+// as suppressed.
+//
+// MediaDebounceTest
+//
+#define DfMiniMp3MediaDebounce 500
+#include <Arduino.h>
+#include <stdio.h>
+#include <vector>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static unsigned s_failures = 0;
+
+struct media_t
+{
+    uint8_t command;
+    uint16_t sources;
+};
+
+static std::vector<media_t> s_notified;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources sources)
+    {
+        s_notified.push_back(media_t{ Mp3_Replies_PlaySource_Online, sources });
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources sources)
+    {
+        s_notified.push_back(media_t{ Mp3_Replies_PlaySource_Inserted, sources });
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources sources)
+    {
+        s_notified.push_back(media_t{ Mp3_Replies_PlaySource_Removed, sources });
+    }
+};
+
+typedef DFMiniMp3<Mp3HostSerial, Mp3Notify> DfMp3;
+
+static void check(bool isOk, const char* test, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", test, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+static void run(DfMp3& mp3, uint32_t time)
+{
+    uint32_t started = millis();
+
+    while (millis() - started < time)
+    {
+        mp3.loop();
+        Mp3HostAdvance(1000);
+    }
+}
+
+// reports 100ms apart, within the settle time of each other
+static void bounce(Mp3HostSerial& serial, const uint8_t* commands, size_t count, uint16_t sources)
+{
+    for (size_t index = 0; index < count; index++)
+    {
+        serial.inject(commands[index], sources, static_cast<uint32_t>(index + 1) * 100000);
+    }
+}
+
+static bool isNotified(uint8_t command, uint16_t sources)
+{
+    return (s_notified.size() == 1 &&
+        s_notified[0].command == command &&
+        s_notified[0].sources == sources);
+}
+
+// inserted, removed and inserted again is one insert, taking it out
+// and back in is none
+static void looseCard()
+{
+    const char* test = "loose card";
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    static const uint8_t c_inserted[] = {
+        Mp3_Replies_PlaySource_Inserted,
+        Mp3_Replies_PlaySource_Removed,
+        Mp3_Replies_PlaySource_Inserted };
+    static const uint8_t c_reseated[] = {
+        Mp3_Replies_PlaySource_Removed,
+        Mp3_Replies_PlaySource_Inserted };
+
+    mp3.begin();
+    s_notified.clear();
+    bounce(serial, c_inserted, sizeof(c_inserted), DfMp3_PlaySources_Sd);
+    run(mp3, 500);
+    check(s_notified.empty(), test, "notified before settled", s_notified.size());
+    run(mp3, 1000);
+    check(isNotified(Mp3_Replies_PlaySource_Inserted, DfMp3_PlaySources_Sd), test, "inserted", s_notified.size());
+    check(mp3.getMediaStats().events == 3, test, "events", mp3.getMediaStats().events);
+    check(mp3.getMediaStats().suppressed == 2, test, "suppressed", mp3.getMediaStats().suppressed);
+
+    s_notified.clear();
+    bounce(serial, c_reseated, sizeof(c_reseated), DfMp3_PlaySources_Sd);
+    run(mp3, 1500);
+    check(s_notified.empty(), test, "reseated notified", s_notified.size());
+    check(mp3.getMediaStats().suppressed == 4, test, "reseated suppressed", mp3.getMediaStats().suppressed);
+}
+
+// what is removed and inserted after an online report is held with
+// it, the online is notified once with the sources as they settled
+static void online()
+{
+    const char* test = "online";
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    static const uint8_t c_online[] = {
+        Mp3_Replies_PlaySource_Online,
+        Mp3_Replies_PlaySource_Removed };
+
+    mp3.begin();
+    s_notified.clear();
+    bounce(serial, c_online, sizeof(c_online), DfMp3_PlaySources_Sd | DfMp3_PlaySources_Usb);
+    serial.inject(Mp3_Replies_PlaySource_Inserted, DfMp3_PlaySources_Usb, 300000);
+    run(mp3, 2000);
+    check(isNotified(Mp3_Replies_PlaySource_Online, DfMp3_PlaySources_Usb), test, "online", s_notified.size());
+}
+
+int main()
+{
+    looseCard();
+    online();
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+// Decodes a stream of track finished notifications with a share of 
+// them corrupted, for each chip variant and corruption rate, and 
+// reports frames decoded per second of host cpu time and the bytes 
+// dropped per resync, one json object per line.
+//
+// ParserBench [--frames N] [--rate percent]... [--seed N]
+//
+#define DfMiniMp3Stats
+#include <Arduino.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static uint32_t s_decoded = 0;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t) 
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t) 
+    {
+        s_decoded++;
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources) 
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources) 
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources) 
+    {
+    }
+};
+
+static uint32_t s_random = 1;
+
+static uint32_t next()
+{
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 17;
+    s_random ^= s_random << 5;
+    return s_random;
+}
+
+// rate is the percent of frames preceded by noise or a bad frame
+static std::vector<uint8_t> buildStream(uint32_t frames, uint32_t rate)
+{
+    std::vector<uint8_t> stream;
+    uint8_t packet[10];
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        if (next() % 100 < rate)
+        {
+            Mp3HostSerial::frame(packet, Mp3_Replies_TrackFinished_Sd, 0);
+            if (next() % 2)
+            {
+                // cut short
+                stream.insert(stream.end(), packet, packet + 1 + next() % 9);
+            }
+            else
+            {
+                for (uint32_t count = 1 + next() % 8; count; count--)
+                {
+                    stream.push_back((next() % 3 == 0) ? Mp3_PacketStartCode : static_cast<uint8_t>(next()));
+                }
+            }
+        }
+        // distinct tracks, a repeated one may be taken as a duplicate
+        Mp3HostSerial::frame(packet, Mp3_Replies_TrackFinished_Sd, static_cast<uint16_t>(frame + 1));
+        stream.insert(stream.end(), packet, packet + sizeof(packet));
+    }
+    return stream;
+}
+
+template <class T_CHIP_VARIANT> void bench(const char* variant, uint32_t frames, uint32_t rate)
+{
+    typedef DFMiniMp3<Mp3HostSerial, Mp3Notify, T_CHIP_VARIANT> DfMp3;
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    std::vector<uint8_t> stream = buildStream(frames, rate);
+
+    serial.setTimeout(5);
+    serial.inject(stream.data(), stream.size());
+    s_decoded = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while (serial.pending() >= 10)
+    {
+        mp3.loop();
+    }
+    mp3.loop();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const DfMp3_ReceptionStats& stats = mp3.getReceptionStats();
+
+    printf("{\"variant\":\"%s\",\"frames\":%u,\"corruptionPercent\":%u,\"decoded\":%u,"
+        "\"framesPerSecond\":%.0f,\"resyncs\":%u,\"bytesDiscarded\":%u,\"bytesPerResync\":%.2f}\n",
+        variant,
+        static_cast<unsigned>(frames),
+        static_cast<unsigned>(rate),
+        static_cast<unsigned>(s_decoded),
+        (seconds > 0) ? (s_decoded / seconds) : 0.0,
+        static_cast<unsigned>(stats.resyncs),
+        static_cast<unsigned>(stats.bytesDiscarded),
+        stats.resyncs ? (static_cast<double>(stats.bytesDiscarded) / stats.resyncs) : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t frames = 100000;
+    std::vector<uint32_t> rates;
+
+    for (int arg = 1; arg + 1 < argc; arg += 2)
+    {
+        if (strcmp(argv[arg], "--frames") == 0)
+        {
+            frames = static_cast<uint32_t>(atol(argv[arg + 1]));
+        }
+        else if (strcmp(argv[arg], "--rate") == 0)
+        {
+            rates.push_back(static_cast<uint32_t>(atol(argv[arg + 1])));
+        }
+        else if (strcmp(argv[arg], "--seed") == 0)
+        {
+            s_random = static_cast<uint32_t>(atol(argv[arg + 1]));
+        }
+    }
+    if (rates.empty())
+    {
+        rates = { 0, 1, 10, 30 };
+    }
+
+    for (size_t index = 0; index < rates.size(); index++)
+    {
+        bench<Mp3ChipOriginal>("Mp3ChipOriginal", frames, rates[index]);
+        bench<Mp3ChipMH2024K16SS>("Mp3ChipMH2024K16SS", frames, rates[index]);
+        bench<Mp3ChipIncongruousNoAck>("Mp3ChipIncongruousNoAck", frames, rates[index]);
+    }
+    return 0;
+}
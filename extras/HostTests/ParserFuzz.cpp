@@ -0,0 +1,238 @@
+// Fuzzes the reception path, readPacket() and listenForReply(), for
+// each chip variant with truncated frames, bad versions, lengths, end 
+// codes and checksums, and garbage between frames.  Fails when a 
+// valid frame is lost or a loop() call does not return promptly.
+//
+// ParserFuzz [rounds] [seed]
+//
+#define DfMiniMp3Stats
+#include <Arduino.h>
+#include <stdlib.h>
+#include <vector>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static std::vector<uint16_t> s_finished;
+static unsigned s_failures = 0;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t) 
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t track) 
+    {
+        s_finished.push_back(track);
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources) 
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources) 
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources) 
+    {
+    }
+};
+
+static uint32_t s_random = 1;
+
+static uint32_t next()
+{
+    // xorshift32, the same stream on every host
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 17;
+    s_random ^= s_random << 5;
+    return s_random;
+}
+
+enum Corruption
+{
+    Corruption_None,
+    Corruption_Garbage,
+    Corruption_Truncated,
+    Corruption_Version,
+    Corruption_Length,
+    Corruption_EndCode,
+    Corruption_Checksum,
+    Corruption_Count
+};
+
+static void check(bool isOk, const char* variant, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", variant, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+// what may come before a valid frame, never more than a 
+// readPacket() call may drop before giving up on the stream
+static void corrupt(std::vector<uint8_t>* stream, uint16_t track)
+{
+    uint8_t packet[10];
+
+    Mp3HostSerial::frame(packet, Mp3_Replies_TrackFinished_Sd, track ^ 0x5555);
+    switch (next() % Corruption_Count)
+    {
+    case Corruption_Garbage:
+        for (uint32_t count = 1 + next() % 8; count; count--)
+        {
+            // start codes in the noise are the hard part
+            stream->push_back((next() % 3 == 0) ? Mp3_PacketStartCode : static_cast<uint8_t>(next()));
+        }
+        return;
+
+    case Corruption_Truncated:
+        stream->insert(stream->end(), packet, packet + 1 + next() % 9);
+        return;
+
+    case Corruption_Version:
+        packet[1] ^= 1 + next() % 0xfe;
+        break;
+
+    case Corruption_Length:
+        packet[2] ^= 1 + next() % 0xfe;
+        break;
+
+    case Corruption_EndCode:
+        packet[9] ^= 1 + next() % 0xfe;
+        break;
+
+    case Corruption_Checksum:
+        packet[7 + next() % 2] ^= 1 + next() % 0xfe;
+        break;
+
+    default:
+        return;
+    }
+    stream->insert(stream->end(), packet, packet + sizeof(packet));
+}
+
+template <class T_CHIP_VARIANT> void fuzzNotifications(const char* variant, uint16_t frames)
+{
+    typedef DFMiniMp3<Mp3HostSerial, Mp3Notify, T_CHIP_VARIANT> DfMp3;
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    std::vector<uint8_t> stream;
+    uint8_t packet[10];
+
+    for (uint16_t track = 1; track <= frames; track++)
+    {
+        corrupt(&stream, track);
+        Mp3HostSerial::frame(packet, Mp3_Replies_TrackFinished_Sd, track);
+        stream.insert(stream.end(), packet, packet + sizeof(packet));
+    }
+    serial.setTimeout(5);
+    serial.inject(stream.data(), stream.size());
+    s_finished.clear();
+
+    // each loop() reads at most a few packets, so it takes a bounded
+    // number of them to get through, and each returns having read
+    // no more than its drains may drop
+    size_t loops = 0;
+    size_t before = serial.pending();
+
+    while (serial.pending() >= 10 && loops < stream.size())
+    {
+        mp3.loop();
+        check(before - serial.pending() <= 6 * 40, variant, "loop() read too much", before - serial.pending());
+        before = serial.pending();
+        loops++;
+    }
+    mp3.loop();
+    check(loops < stream.size(), variant, "hang reading the stream", loops);
+
+    check(s_finished.size() == frames, variant, "frames lost", frames - s_finished.size());
+    for (size_t index = 0; index < s_finished.size(); index++)
+    {
+        if (s_finished[index] != index + 1)
+        {
+            check(false, variant, "frame out of order", index);
+            break;
+        }
+    }
+}
+
+template <class T_CHIP_VARIANT> void fuzzReplies(const char* variant, uint16_t queries)
+{
+    typedef DFMiniMp3<Mp3HostSerial, Mp3Notify, T_CHIP_VARIANT> DfMp3;
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    std::vector<uint8_t> noise;
+
+    for (uint16_t query = 0; query < queries; query++)
+    {
+        // the reply follows whatever corruption came before it
+        noise.clear();
+        corrupt(&noise, query);
+        serial.inject(noise.data(), noise.size());
+        serial.volume = query % 31;
+
+        uint16_t volume = mp3.getVolume();
+
+        check(volume == query % 31, variant, "reply lost", query);
+        mp3.loop();
+        while (serial.pending())
+        {
+            mp3.loop();
+            delay(10);
+        }
+    }
+}
+
+// a stream of noise full of start codes may not hold up loop()
+template <class T_CHIP_VARIANT> void noiseStorm(const char* variant)
+{
+    typedef DFMiniMp3<Mp3HostSerial, Mp3Notify, T_CHIP_VARIANT> DfMp3;
+    static const uint8_t c_noise[] = { 0x7e, 0x01, 0x02, 0x03, 0x04 };
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+
+    for (uint32_t count = 0; count < 20000; count++)
+    {
+        serial.inject(c_noise, sizeof(c_noise));
+    }
+    serial.inject(Mp3_Replies_TrackFinished_Sd, 7);
+    s_finished.clear();
+
+    size_t before = serial.pending();
+
+    mp3.loop();
+    check(before - serial.pending() <= 6 * 40, variant, "loop() blocked on noise", before - serial.pending());
+
+    for (uint32_t loops = 0; serial.pending() && loops < 100000; loops++)
+    {
+        mp3.loop();
+    }
+    mp3.loop();
+    check(mp3.getReceptionStats().errorsHeader > 0, variant, "noise not reported", 0);
+}
+
+template <class T_CHIP_VARIANT> void fuzz(const char* variant, uint16_t rounds)
+{
+    fuzzNotifications<T_CHIP_VARIANT>(variant, rounds);
+    fuzzReplies<T_CHIP_VARIANT>(variant, rounds / 8);
+    noiseStorm<T_CHIP_VARIANT>(variant);
+    printf("%s done\n", variant);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t rounds = (argc > 1) ? static_cast<uint16_t>(atoi(argv[1])) : 4000;
+
+    s_random = (argc > 2) ? static_cast<uint32_t>(atoi(argv[2])) : 1;
+
+    fuzz<Mp3ChipOriginal>("Mp3ChipOriginal", rounds);
+    fuzz<Mp3ChipMH2024K16SS>("Mp3ChipMH2024K16SS", rounds);
+    fuzz<Mp3ChipIncongruousNoAck>("Mp3ChipIncongruousNoAck", rounds);
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+// Asks queries through DfMiniMp3QueryCache against an emulated module.
+// Fails when a reply within maxAge is asked again, when one is kept
+// past an action or the volume past a track finished, or when a thread
+// asking the query another has on the wire does not take its reply.
+//
+// QueryCacheTest
+//
+#define DfMiniMp3QueryCache 4
+#include <Arduino.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "DFMiniMp3.h"
+#include "Mp3LockPolicy.h"
+#include "Mp3HostSerial.h"
+
+static unsigned s_failures = 0;
+
+// holds the first status query on the wire for a while, with
+// isSent set, so another thread can ask it meanwhile
+class HoldSerial : public Mp3HostSerial
+{
+public:
+    HoldSerial() :
+        isHolding(false),
+        isSent(false)
+    {
+    }
+
+    bool isHolding;
+    std::atomic<bool> isSent;
+
+    size_t write(const uint8_t* data, size_t size)
+    {
+        size_t written = Mp3HostSerial::write(data, size);
+
+        if (isHolding && size >= 8 && data[3] == Mp3_Commands_GetStatus)
+        {
+            isHolding = false;
+            isSent = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return written;
+    }
+};
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources)
+    {
+    }
+};
+
+typedef DFMiniMp3<HoldSerial, Mp3Notify, Mp3ChipOriginal, 900, Mp3LockStdMutex> DfMp3;
+
+static void check(bool isOk, const char* test, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", test, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+static void run(DfMp3& mp3, uint32_t time)
+{
+    uint32_t started = millis();
+
+    while (millis() - started < time)
+    {
+        mp3.loop();
+        Mp3HostAdvance(1000);
+    }
+}
+
+// a reply within maxAge is given again, an older one is asked again
+static void cacheHit()
+{
+    const char* test = "cache hit";
+    HoldSerial serial;
+    DfMp3 mp3(serial);
+
+    mp3.begin();
+    serial.status = 0x0201;
+    mp3.getStatus(1000);
+    serial.status = 0x0200;
+    DfMp3_Status status = mp3.getStatus(1000);
+
+    check(serial.commands[Mp3_Commands_GetStatus] == 1, test, "sends", serial.commands[Mp3_Commands_GetStatus]);
+    check(status.state == DfMp3_StatusState_Playing, test, "cached status", status.state);
+
+    Mp3HostAdvance(1500000);
+    status = mp3.getStatus(1000);
+    check(serial.commands[Mp3_Commands_GetStatus] == 2, test, "sends when old", serial.commands[Mp3_Commands_GetStatus]);
+    check(status.state == DfMp3_StatusState_Idle, test, "status when old", status.state);
+}
+
+// setting the volume forgets the one kept, the volume keys change it
+// too so it is not kept past a track finished, the eq is
+static void invalidation()
+{
+    const char* test = "invalidation";
+    HoldSerial serial;
+    DfMp3 mp3(serial);
+
+    mp3.begin();
+    serial.volume = 15;
+    mp3.getVolume(60000);
+    mp3.query<Mp3_Command_GetEq>(0, 60000);
+    check(mp3.getVolume(60000) == 15, test, "cached volume", 0);
+    check(serial.commands[Mp3_Commands_GetVolume] == 1, test, "sends", serial.commands[Mp3_Commands_GetVolume]);
+
+    mp3.setVolume(20);
+    check(mp3.getVolume(60000) == 20, test, "volume after set", 0);
+    check(serial.commands[Mp3_Commands_GetVolume] == 2, test, "sends after set", serial.commands[Mp3_Commands_GetVolume]);
+
+    mp3.query<Mp3_Command_GetEq>(0, 60000);
+    serial.volume = 25;
+    serial.inject(Mp3_Replies_TrackFinished_Sd, 1);
+    run(mp3, 100);
+    check(mp3.getVolume(60000) == 25, test, "volume after track finished", 0);
+    mp3.query<Mp3_Command_GetEq>(0, 60000);
+    check(serial.commands[Mp3_Commands_GetEq] == 2, test, "eq sends", serial.commands[Mp3_Commands_GetEq]);
+}
+
+// a thread asking while the same query is on the wire takes its reply
+static void singleFlight()
+{
+    const char* test = "single flight";
+    HoldSerial serial;
+    DfMp3 mp3(serial);
+    DfMp3_Status first = {};
+    DfMp3_Status second = {};
+
+    mp3.begin();
+    serial.status = 0x0201;
+    serial.isHolding = true;
+
+    std::thread asking([&]()
+        {
+            first = mp3.getStatus();
+        });
+    while (!serial.isSent)
+    {
+        std::this_thread::yield();
+    }
+    second = mp3.getStatus();
+    asking.join();
+
+    check(serial.commands[Mp3_Commands_GetStatus] == 1, test, "sends", serial.commands[Mp3_Commands_GetStatus]);
+    check(first.state == DfMp3_StatusState_Playing, test, "first status", first.state);
+    check(second.state == DfMp3_StatusState_Playing, test, "second status", second.state);
+}
+
+int main()
+{
+    cacheHit();
+    invalidation();
+    singleFlight();
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+// Calls getStatus() from OnPlayFinished, run from loop(), while the
+// next track finished arrives during the query.  Fails when the query
+// does not return its reply, or a track finished is not notified once,
+// in order, after the one being handled has returned.
+//
+// ReentryTest, built once more with DfMiniMp3PendingCommands
+//
+#include <Arduino.h>
+#include <stdio.h>
+#include <vector>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static unsigned s_failures = 0;
+
+// a track finished arrives with the first status query on the wire
+class FinishingSerial : public Mp3HostSerial
+{
+public:
+    FinishingSerial() :
+        isFinishing(true)
+    {
+    }
+
+    bool isFinishing;
+
+    size_t write(const uint8_t* data, size_t size)
+    {
+        if (isFinishing && size >= 8 && data[3] == Mp3_Commands_GetStatus)
+        {
+            isFinishing = false;
+            inject(Mp3_Replies_TrackFinished_Sd, 2, latency / 4);
+        }
+        return Mp3HostSerial::write(data, size);
+    }
+};
+
+static std::vector<uint16_t> s_finished;
+static std::vector<uint16_t> s_statuses;
+static unsigned s_depth = 0;
+static unsigned s_depthMax = 0;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T& mp3, DfMp3_PlaySources, uint16_t track)
+    {
+        s_depth++;
+        if (s_depth > s_depthMax)
+        {
+            s_depthMax = s_depth;
+        }
+        s_finished.push_back(track);
+        s_statuses.push_back(mp3.getStatus().state);
+        s_depth--;
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources)
+    {
+    }
+};
+
+typedef DFMiniMp3<FinishingSerial, Mp3Notify> DfMp3;
+
+static void check(bool isOk, const char* test, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", test, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+static void queryInNotification()
+{
+    const char* test = "query in notification";
+    FinishingSerial serial;
+    DfMp3 mp3(serial);
+    uint32_t started;
+
+    mp3.begin();
+    serial.status = 0x0200;
+    serial.inject(Mp3_Replies_TrackFinished_Sd, 1, 1000);
+    started = millis();
+    while (millis() - started < 2000)
+    {
+        mp3.loop();
+        Mp3HostAdvance(1000);
+    }
+
+    check(s_finished.size() == 2, test, "notified", s_finished.size());
+    check(s_finished.size() == 2 && s_finished[0] == 1 && s_finished[1] == 2, test, "order", 0);
+    check(s_depthMax == 1, test, "notified from within one", s_depthMax);
+    check(serial.commands[Mp3_Commands_GetStatus] == 2, test, "queries", serial.commands[Mp3_Commands_GetStatus]);
+    for (uint16_t state : s_statuses)
+    {
+        check(state == DfMp3_StatusState_Idle, test, "status", state);
+    }
+}
+
+int main()
+{
+    queryInNotification();
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// Captures a session with DfMiniMp3Trace, dumps it and plays it back
+// through Mp3TraceReplaySerial.  Fails when the same calls do not get
+// the same answers without mismatches, or when a replay that differs
+// at one point, by a write, a read or a call left out, does not
+// report it there and keep in step after it.
+//
+// ReplayTest
+//
+#define DfMiniMp3Trace 32
+#include <Arduino.h>
+#include <stdio.h>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+#include "Mp3TraceReplaySerial.h"
+
+static unsigned s_failures = 0;
+static unsigned s_finished = 0;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t)
+    {
+        s_finished++;
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources)
+    {
+    }
+};
+
+typedef DFMiniMp3<Mp3HostSerial, Mp3Notify> DfMp3;
+typedef DFMiniMp3<Mp3TraceReplaySerial, Mp3Notify> DfMp3Replay;
+
+static void check(bool isOk, const char* test, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", test, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+static void run(DfMp3Replay& mp3, uint32_t time)
+{
+    uint32_t started = millis();
+
+    while (millis() - started < time)
+    {
+        mp3.loop();
+        Mp3HostAdvance(1000);
+    }
+}
+
+// the dump of a session setting and reading the volume, then waiting
+// out a track before reading the status
+static size_t capture(DfMp3_TraceRecord* records, size_t recordCount)
+{
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    char dump[sizeof(DfMp3_TraceRecord) * DfMiniMp3Trace + 1];
+    Print out(dump, sizeof(dump));
+
+    mp3.begin();
+    serial.status = 0x0200;
+    mp3.setVolume(12);
+    mp3.getVolume();
+    serial.inject(Mp3_Replies_TrackFinished_Sd, 1, 500000);
+    for (uint32_t started = millis(); millis() - started < 1000; Mp3HostAdvance(1000))
+    {
+        mp3.loop();
+    }
+    mp3.getStatus();
+
+    mp3.dumpTrace(out);
+    if (recordCount > out.length() / sizeof(DfMp3_TraceRecord))
+    {
+        recordCount = out.length() / sizeof(DfMp3_TraceRecord);
+    }
+    memcpy(records, dump, recordCount * sizeof(DfMp3_TraceRecord));
+    return recordCount;
+}
+
+// the same calls get the same answers
+static void roundTrip(const DfMp3_TraceRecord* records, size_t recordCount)
+{
+    const char* test = "round trip";
+    Mp3TraceReplaySerial serial(records, recordCount);
+    DfMp3Replay mp3(serial);
+    size_t mismatch = 0;
+
+    s_finished = 0;
+    mp3.begin();
+    mp3.setVolume(12);
+    check(mp3.getVolume() == 12, test, "volume", 0);
+    run(mp3, 1000);
+    DfMp3_Status status = mp3.getStatus();
+
+    check(status.state == DfMp3_StatusState_Idle, test, "status", status.state);
+    check(s_finished == 1, test, "track finished", s_finished);
+    check(serial.isComplete(), test, "records left", serial.getPosition());
+    check(serial.getMismatches() == 0, test, "mismatches", serial.getMismatches());
+    check(!serial.getFirstMismatch(&mismatch), test, "first mismatch", mismatch);
+}
+
+// a different volume is one mismatch, the rest still replays
+static void differentWrite(const DfMp3_TraceRecord* records, size_t recordCount)
+{
+    const char* test = "different write";
+    Mp3TraceReplaySerial serial(records, recordCount);
+    DfMp3Replay mp3(serial);
+    size_t mismatch = 0;
+
+    mp3.begin();
+    mp3.setVolume(13);
+    size_t setVolume = serial.getPosition() - 2;
+    check(mp3.getVolume() == 12, test, "volume", 0);
+    run(mp3, 1000);
+    DfMp3_Status status = mp3.getStatus();
+
+    check(status.state == DfMp3_StatusState_Idle, test, "status", status.state);
+    check(serial.isComplete(), test, "records left", serial.getPosition());
+    check(serial.getMismatches() == 1, test, "mismatches", serial.getMismatches());
+    check(serial.getFirstMismatch(&mismatch) && mismatch == setVolume, test, "first mismatch", mismatch);
+}
+
+// not waiting out the track leaves its finished unread when the status
+// is asked for, the replay skips it and carries on from there
+static void skippedRead(const DfMp3_TraceRecord* records, size_t recordCount)
+{
+    const char* test = "skipped read";
+    Mp3TraceReplaySerial serial(records, recordCount);
+    DfMp3Replay mp3(serial);
+    size_t mismatch = 0;
+
+    mp3.begin();
+    mp3.setVolume(12);
+    check(mp3.getVolume() == 12, test, "volume", 0);
+    size_t finished = serial.getPosition();
+    DfMp3_Status status = mp3.getStatus();
+
+    check(status.state == DfMp3_StatusState_Idle, test, "status", status.state);
+    check(serial.isComplete(), test, "records left", serial.getPosition());
+    check(serial.getMismatches() == 1, test, "mismatches", serial.getMismatches());
+    check(serial.getFirstMismatch(&mismatch) && mismatch == finished, test, "first mismatch", mismatch);
+}
+
+// leaving out the volume read resyncs at the status
+static void skippedCall(const DfMp3_TraceRecord* records, size_t recordCount)
+{
+    const char* test = "skipped call";
+    Mp3TraceReplaySerial serial(records, recordCount);
+    DfMp3Replay mp3(serial);
+    size_t mismatch = 0;
+
+    mp3.begin();
+    mp3.setVolume(12);
+    size_t getVolume = serial.getPosition();
+    DfMp3_Status status = mp3.getStatus();
+
+    check(status.state == DfMp3_StatusState_Idle, test, "status", status.state);
+    check(serial.isComplete(), test, "records left", serial.getPosition());
+    check(serial.getMismatches() == 1, test, "mismatches", serial.getMismatches());
+    check(serial.getFirstMismatch(&mismatch) && mismatch == getVolume, test, "first mismatch", mismatch);
+}
+
+int main()
+{
+    DfMp3_TraceRecord records[DfMiniMp3Trace];
+    size_t recordCount = capture(records, DfMiniMp3Trace);
+
+    check(recordCount >= 7, "capture", "records", recordCount);
+    roundTrip(records, recordCount);
+    differentWrite(records, recordCount);
+    skippedRead(records, recordCount);
+    skippedCall(records, recordCount);
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
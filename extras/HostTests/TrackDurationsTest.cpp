@@ -0,0 +1,123 @@
+// Plays tracks to their end with DfMiniMp3TrackDurations.  Fails when
+// the duration learned from the track finished is not the time played
+// less any pause, also when the play is acked as millis() wraps to 0.
+//
+// TrackDurationsTest
+//
+#define DfMiniMp3TrackDurations 8
+#include <Arduino.h>
+#include <stdio.h>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static unsigned s_failures = 0;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources)
+    {
+    }
+};
+
+typedef DFMiniMp3<Mp3HostSerial, Mp3Notify> DfMp3;
+
+static const uint16_t c_Track = (1 << 8) | 3; // folder 01, track 003
+
+static void check(bool isOk, const char* test, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", test, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+static void run(DfMp3& mp3, uint32_t time)
+{
+    uint32_t started = millis();
+
+    while (millis() - started < time)
+    {
+        mp3.loop();
+        Mp3HostAdvance(1000);
+    }
+}
+
+// plays 01/003 for 10s, with a 3s pause when isPausing
+static void learned(const char* test, bool isPausing)
+{
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    uint32_t remaining = 0;
+
+    mp3.begin();
+    mp3.playFolderTrack(1, 3);
+    if (isPausing)
+    {
+        run(mp3, 4000);
+        mp3.pause();
+        run(mp3, 3000);
+        mp3.start();
+        run(mp3, 6000);
+    }
+    else
+    {
+        run(mp3, 10000);
+    }
+    check(!mp3.getTrackRemaining(&remaining), test, "remaining before learned", remaining);
+    serial.inject(Mp3_Replies_TrackFinished_Sd, 3);
+    run(mp3, 100);
+
+    uint32_t duration = mp3.getTrackDuration(Mp3_Commands_PlayFolderTrack, c_Track);
+
+    check(mp3.getTrackDurationCount() == 1, test, "learned", mp3.getTrackDurationCount());
+    check(duration >= 9900 && duration <= 10100, test, "duration", duration);
+}
+
+// the ack arrives at millis() 0, which is as good a start as any
+static void wrapped()
+{
+    const char* test = "wrapped";
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+
+    mp3.begin();
+    Mp3HostMicros() = (static_cast<uint64_t>(1) << 32) * 1000 - serial.latency;
+    mp3.playFolderTrack(1, 3);
+    check(millis() == 0, test, "acked at", millis());
+    run(mp3, 10000);
+    serial.inject(Mp3_Replies_TrackFinished_Sd, 3);
+    run(mp3, 100);
+
+    uint32_t duration = mp3.getTrackDuration(Mp3_Commands_PlayFolderTrack, c_Track);
+
+    check(mp3.getTrackDurationCount() == 1, test, "learned", mp3.getTrackDurationCount());
+    check(duration >= 9900 && duration <= 10100, test, "duration", duration);
+}
+
+int main()
+{
+    learned("learned", false);
+    learned("paused", true);
+    wrapped();
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
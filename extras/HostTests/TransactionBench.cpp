@@ -0,0 +1,199 @@
+// Runs whole transactions through DFMiniMp3 for each chip variant 
+// under scripted link conditions, and reports as json lines
+//   encode - host ns per generatePacket()
+//   setCommand, getCommand - host cpu ns per call, and the latency
+//       on the simulated wire as p50, p90, p99 and max in micros
+//   dispatch - host ns per notification from loop() to the callback
+//
+// TransactionBench [--count N]
+//
+#include <Arduino.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static uint32_t s_dispatched = 0;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t) 
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t) 
+    {
+        s_dispatched++;
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources) 
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources) 
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources) 
+    {
+    }
+};
+
+struct Link
+{
+    const char* name;
+    uint32_t latency; // micros to the ack or reply
+    uint32_t dropEvery; // every nth ack or reply lost, 0 for none
+};
+
+static const Link c_links[] = 
+{
+    { "ideal", 0, 0 },
+    { "typical", 20000, 0 },
+    { "slow", 120000, 0 },
+    { "lossy", 20000, 10 },
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double nanosSince(Clock::time_point start, uint32_t count)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+}
+
+// latencies in micros, sorted in place
+static void printDistribution(std::vector<uint32_t>* latencies)
+{
+    std::sort(latencies->begin(), latencies->end());
+
+    size_t last = latencies->size() - 1;
+
+    printf("\"p50Us\":%u,\"p90Us\":%u,\"p99Us\":%u,\"maxUs\":%u",
+        static_cast<unsigned>((*latencies)[last * 50 / 100]),
+        static_cast<unsigned>((*latencies)[last * 90 / 100]),
+        static_cast<unsigned>((*latencies)[last * 99 / 100]),
+        static_cast<unsigned>((*latencies)[last]));
+}
+
+template <class T_CHIP_VARIANT> void benchEncode(const char* variant, uint32_t count)
+{
+    volatile uint8_t sink = 0;
+    Clock::time_point start = Clock::now();
+
+    for (uint32_t index = 0; index < count; index++)
+    {
+        typename T_CHIP_VARIANT::SendPacket packet = 
+            T_CHIP_VARIANT::generatePacket(Mp3_Commands_PlayFolderTrack, static_cast<uint16_t>(index), true);
+
+        sink = sink + T_CHIP_VARIANT::toWire(&packet) + packet.lowByteArgument;
+    }
+    printf("{\"variant\":\"%s\",\"measure\":\"encode\",\"count\":%u,\"ns\":%.1f}\n", 
+        variant, 
+        static_cast<unsigned>(count), 
+        nanosSince(start, count));
+}
+
+template <class T_CHIP_VARIANT> void benchTransactions(const char* variant, const Link& link, uint32_t count)
+{
+    typedef DFMiniMp3<Mp3HostSerial, Mp3Notify, T_CHIP_VARIANT> DfMp3;
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    std::vector<uint32_t> latencies;
+    Clock::time_point start;
+
+    serial.latency = link.latency;
+    serial.dropEvery = link.dropEvery;
+
+    for (int query = 0; query < 2; query++)
+    {
+        const char* measure = query ? "getCommand" : "setCommand";
+        double cpu = 0;
+
+        latencies.clear();
+        for (uint32_t index = 0; index < count; index++)
+        {
+            uint64_t began = Mp3HostMicros();
+
+            start = Clock::now();
+            if (query)
+            {
+                mp3.getVolume();
+            }
+            else
+            {
+                mp3.setVolume(static_cast<uint8_t>(index % 31));
+            }
+            cpu += nanosSince(start, 1);
+            latencies.push_back(static_cast<uint32_t>(Mp3HostMicros() - began));
+
+            // the module is given a moment between commands
+            delay(5);
+            mp3.loop();
+        }
+
+        printf("{\"variant\":\"%s\",\"link\":\"%s\",\"measure\":\"%s\",\"count\":%u,\"cpuNs\":%.1f,",
+            variant, 
+            link.name, 
+            measure, 
+            static_cast<unsigned>(count), 
+            cpu / count);
+        printDistribution(&latencies);
+        printf("}\n");
+    }
+}
+
+template <class T_CHIP_VARIANT> void benchDispatch(const char* variant, uint32_t count)
+{
+    typedef DFMiniMp3<Mp3HostSerial, Mp3Notify, T_CHIP_VARIANT> DfMp3;
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+
+    for (uint32_t index = 0; index < count; index++)
+    {
+        // distinct tracks, a repeated one may be taken as a duplicate
+        serial.inject(Mp3_Replies_TrackFinished_Sd, static_cast<uint16_t>(index + 1));
+    }
+    s_dispatched = 0;
+
+    Clock::time_point start = Clock::now();
+
+    while (s_dispatched < count)
+    {
+        mp3.loop();
+    }
+    printf("{\"variant\":\"%s\",\"measure\":\"dispatch\",\"count\":%u,\"ns\":%.1f}\n", 
+        variant, 
+        static_cast<unsigned>(count), 
+        nanosSince(start, count));
+}
+
+template <class T_CHIP_VARIANT> void bench(const char* variant, uint32_t count)
+{
+    benchEncode<T_CHIP_VARIANT>(variant, count * 100);
+    for (size_t link = 0; link < sizeof(c_links) / sizeof(c_links[0]); link++)
+    {
+        benchTransactions<T_CHIP_VARIANT>(variant, c_links[link], count);
+    }
+    benchDispatch<T_CHIP_VARIANT>(variant, count * 10);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t count = 2000;
+
+    for (int arg = 1; arg + 1 < argc; arg += 2)
+    {
+        if (strcmp(argv[arg], "--count") == 0)
+        {
+            count = static_cast<uint32_t>(atol(argv[arg + 1]));
+        }
+    }
+
+    bench<Mp3ChipOriginal>("Mp3ChipOriginal", count);
+    bench<Mp3ChipMH2024K16SS>("Mp3ChipMH2024K16SS", count);
+    bench<Mp3ChipIncongruousNoAck>("Mp3ChipIncongruousNoAck", count);
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Runs Mp3PlaybackWatchdog against an emulated module.  Fails when a
+// play the module rejects leaves playback expected, so the watchdog
+// takes a stopped module for a stall and resets it, or when a real
+// stall is not recovered.
+//
+// WatchdogTest
+//
+#include <Arduino.h>
+#include <stdio.h>
+#include "DFMiniMp3.h"
+#include "Mp3HostSerial.h"
+
+static unsigned s_failures = 0;
+
+class Mp3Notify
+{
+public:
+    template <class T> static void OnError(T&, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t)
+    {
+    }
+
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources)
+    {
+    }
+
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources)
+    {
+    }
+};
+
+typedef DFMiniMp3<Mp3HostSerial, Mp3Notify> DfMp3;
+
+static const uint16_t c_Idle = 0x0200;
+static const uint16_t c_Playing = 0x0201;
+
+static void check(bool isOk, const char* test, const char* what, uint32_t detail)
+{
+    if (!isOk)
+    {
+        printf("FAIL %s: %s (%u)\n", test, what, static_cast<unsigned>(detail));
+        s_failures++;
+    }
+}
+
+static void run(DfMp3& mp3, Mp3PlaybackWatchdog<DfMp3>& watchdog, uint32_t time)
+{
+    uint32_t started = millis();
+
+    while (millis() - started < time)
+    {
+        mp3.loop();
+        watchdog.loop();
+        Mp3HostAdvance(1000);
+    }
+}
+
+// a missing track is answered with an error and the module stays idle
+static void rejectedPlay()
+{
+    const char* test = "rejected play";
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    Mp3PlaybackWatchdog<DfMp3> watchdog(mp3);
+
+    mp3.begin();
+    serial.status = c_Idle;
+    serial.rejected = Mp3_Commands_PlayFolderTrack;
+    mp3.playFolderTrack(1, 99);
+    check(!mp3.isPlaybackExpected(), test, "playback expected", 0);
+    check(!mp3.replayLastPlay(), test, "rejected play kept for replay", 0);
+
+    run(mp3, watchdog, 60000);
+    check(watchdog.getStats().stalls == 0, test, "stalls", watchdog.getStats().stalls);
+    check(serial.commands[Mp3_Commands_Reset] == 0, test, "resets", serial.commands[Mp3_Commands_Reset]);
+    check(serial.commands[Mp3_Commands_Start] == 0, test, "starts", serial.commands[Mp3_Commands_Start]);
+    check(serial.commands[Mp3_Commands_PlayFolderTrack] <= 3, test, "plays", serial.commands[Mp3_Commands_PlayFolderTrack]);
+}
+
+// what played before a rejected play is still watched
+static void rejectedAfterPlaying()
+{
+    const char* test = "rejected after playing";
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    Mp3PlaybackWatchdog<DfMp3> watchdog(mp3);
+
+    mp3.begin();
+    mp3.playFolderTrack(1, 1);
+    serial.rejected = Mp3_Commands_PlayFolderTrack;
+    mp3.playFolderTrack(1, 99);
+    check(mp3.isPlaybackExpected(), test, "playback no longer expected", 0);
+
+    run(mp3, watchdog, 10000);
+    check(watchdog.getStats().stalls == 0, test, "stalls", watchdog.getStats().stalls);
+    check(watchdog.getStats().polls > 0, test, "not polled", 0);
+}
+
+// an acked play that stops without a track finished is restarted
+static void stalled()
+{
+    const char* test = "stalled";
+    Mp3HostSerial serial;
+    DfMp3 mp3(serial);
+    Mp3PlaybackWatchdog<DfMp3> watchdog(mp3);
+
+    mp3.begin();
+    mp3.playFolderTrack(1, 1);
+    run(mp3, watchdog, 5000);
+    serial.status = c_Idle;
+    run(mp3, watchdog, 3000);
+    serial.status = c_Playing;
+    run(mp3, watchdog, 10000);
+
+    check(watchdog.getStats().stalls == 1, test, "stalls", watchdog.getStats().stalls);
+    check(watchdog.getStats().recoveredByStart == 1, test, "not recovered by start", watchdog.getStats().recoveredByStart);
+    check(serial.commands[Mp3_Commands_Reset] == 0, test, "resets", serial.commands[Mp3_Commands_Reset]);
+}
+
+int main()
+{
+    rejectedPlay();
+    rejectedAfterPlaying();
+    stalled();
+
+    printf("%u failures\n", s_failures);
+    return (s_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// host stand-in for the parts of the Arduino core DFMiniMp3 uses,
+// time is simulated, it only moves when a test or a wait moves it
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HEX 16
+#define DEC 10
+#define SERIAL_8N1 0x06
+
+inline uint64_t& Mp3HostMicros()
+{
+    static uint64_t now = 0;
+    return now;
+}
+
+inline void Mp3HostAdvance(uint64_t micros)
+{
+    Mp3HostMicros() += micros;
+}
+
+inline uint32_t millis()
+{
+    return static_cast<uint32_t>(Mp3HostMicros() / 1000);
+}
+
+inline uint32_t micros()
+{
+    return static_cast<uint32_t>(Mp3HostMicros());
+}
+
+inline void delay(uint32_t ms)
+{
+    Mp3HostAdvance(static_cast<uint64_t>(ms) * 1000);
+}
+
+// a spin waiting on time lets it pass
+inline void yield()
+{
+    Mp3HostAdvance(100);
+}
+
+// writes to stdout, or collects into a buffer when given one
+class Print
+{
+public:
+    explicit Print(char* buffer = nullptr, size_t bufferSize = 0) :
+        _buffer(buffer),
+        _bufferSize(bufferSize),
+        _length(0)
+    {
+    }
+
+    size_t write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* data, size_t size)
+    {
+        if (_buffer == nullptr)
+        {
+            return fwrite(data, 1, size, stdout);
+        }
+        for (size_t index = 0; index < size && _length + 1 < _bufferSize; index++)
+        {
+            _buffer[_length++] = static_cast<char>(data[index]);
+        }
+        _buffer[_length] = '\0';
+        return size;
+    }
+
+    size_t length() const
+    {
+        return _length;
+    }
+
+    void print(const char* text)
+    {
+        write(reinterpret_cast<const uint8_t*>(text), strlen(text));
+    }
+
+    void print(char c)
+    {
+        write(static_cast<uint8_t>(c));
+    }
+
+    void print(int value, int base = DEC)
+    {
+        print(static_cast<long>(value), base);
+    }
+
+    void print(unsigned int value, int base = DEC)
+    {
+        print(static_cast<unsigned long>(value), base);
+    }
+
+    void print(long value, int base = DEC)
+    {
+        char text[24];
+
+        snprintf(text, sizeof(text), (base == HEX) ? "%lx" : "%ld", value);
+        print(text);
+    }
+
+    void print(unsigned long value, int base = DEC)
+    {
+        char text[24];
+
+        snprintf(text, sizeof(text), (base == HEX) ? "%lx" : "%lu", value);
+        print(text);
+    }
+
+    void println()
+    {
+        print("\n");
+    }
+
+    template <class T> void println(T value)
+    {
+        print(value);
+        println();
+    }
+
+private:
+    char* _buffer;
+    size_t _bufferSize;
+    size_t _length;
+};
+
+typedef Print Stream;
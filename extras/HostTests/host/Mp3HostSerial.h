@@ -0,0 +1,205 @@
+// a T_SERIAL_METHOD for host tests, plays a module on the other end
+// of the wire; bytes given to it arrive at a simulated time and a read
+// waits for them up to the timeout by moving the simulated time on
+#pragma once
+
+#include <deque>
+#include <vector>
+
+class Mp3HostSerial
+{
+public:
+    Mp3HostSerial() :
+        isAcking(true),
+        latency(20000),
+        volume(15),
+        status(0x0201),
+        queryReply(0x1234),
+        dropEvery(0),
+        dropNext(0),
+        rejected(Mp3_Commands_None),
+        rejectError(DfMp3_Error_FileMismatch),
+        written(0),
+        commands(),
+        _timeout(1000),
+        _answers(0)
+    {
+    }
+
+    bool isAcking; // acks the commands asking for one
+    uint32_t latency; // micros from a command to its ack or reply
+    uint16_t volume; // set by SetVolume, answers GetVolume
+    uint16_t status; // answers GetStatus
+    uint16_t queryReply; // answers every other query
+    uint32_t dropEvery; // every nth ack or reply is lost, 0 for none
+    uint32_t dropNext; // this many of the next acks or replies are lost
+    uint8_t rejected; // answered with rejectError in place of the ack
+    uint16_t rejectError;
+    size_t written; // packets written
+    uint32_t commands[0x100]; // packets written of each command
+
+    void begin(unsigned long)
+    {
+    }
+
+    void begin(unsigned long, uint32_t, int8_t, int8_t)
+    {
+    }
+
+    void setTimeout(unsigned long timeout)
+    {
+        _timeout = timeout;
+    }
+
+    // raw bytes, arriving after delay micros
+    void inject(const uint8_t* data, size_t size, uint32_t delay = 0)
+    {
+        uint64_t due = Mp3HostMicros() + delay;
+
+        for (size_t index = 0; index < size; index++)
+        {
+            _rx.push_back(byte_t{ due, data[index] });
+        }
+    }
+
+    // a well formed packet from the module
+    void inject(uint8_t command, uint16_t arg, uint32_t delay = 0)
+    {
+        uint8_t packet[10];
+
+        frame(packet, command, arg);
+        inject(packet, sizeof(packet), delay);
+    }
+
+    static void frame(uint8_t* packet, uint8_t command, uint16_t arg)
+    {
+        uint16_t sum = Mp3ChipBase::calcChecksum(command, 0, arg);
+
+        packet[0] = Mp3_PacketStartCode;
+        packet[1] = Mp3_PacketVersion;
+        packet[2] = Mp3_PacketLength;
+        packet[3] = command;
+        packet[4] = 0;
+        packet[5] = static_cast<uint8_t>(arg >> 8);
+        packet[6] = static_cast<uint8_t>(arg);
+        packet[7] = static_cast<uint8_t>(sum >> 8);
+        packet[8] = static_cast<uint8_t>(sum);
+        packet[9] = Mp3_PacketEndCode;
+    }
+
+    size_t pending() const
+    {
+        return _rx.size();
+    }
+
+    // capped as a uart's receive buffer would be
+    int available()
+    {
+        int count = 0;
+
+        for (size_t index = 0; 
+                index < _rx.size() && index < c_RxBufferSize && _rx[index].due <= Mp3HostMicros(); 
+                index++)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    size_t readBytes(uint8_t* buffer, size_t length)
+    {
+        uint64_t end = Mp3HostMicros() + static_cast<uint64_t>(_timeout) * 1000;
+        size_t read = 0;
+
+        while (read < length)
+        {
+            if (!_rx.empty() && _rx.front().due <= Mp3HostMicros())
+            {
+                buffer[read++] = _rx.front().value;
+                _rx.pop_front();
+            }
+            else if (!_rx.empty() && _rx.front().due <= end)
+            {
+                Mp3HostMicros() = _rx.front().due;
+            }
+            else
+            {
+                Mp3HostMicros() = end;
+                break;
+            }
+        }
+        return read;
+    }
+
+    size_t write(const uint8_t* data, size_t size)
+    {
+        // with or without the checksum
+        if (size >= 8 && data[0] == Mp3_PacketStartCode)
+        {
+            written++;
+            commands[data[3]]++;
+            answer(data[3], data[4], (static_cast<uint16_t>(data[5]) << 8) | data[6]);
+        }
+        return size;
+    }
+
+private:
+    struct byte_t
+    {
+        uint64_t due;
+        uint8_t value;
+    };
+
+    static const size_t c_RxBufferSize = 64;
+
+    std::deque<byte_t> _rx;
+    unsigned long _timeout;
+    uint32_t _answers;
+
+    bool isDropped()
+    {
+        _answers++;
+        if (dropNext)
+        {
+            dropNext--;
+            return true;
+        }
+        return (dropEvery && (_answers % dropEvery) == 0);
+    }
+
+    void answer(uint8_t command, uint8_t requestAck, uint16_t arg)
+    {
+        if (command > Mp3_Commands_Requests)
+        {
+            uint16_t reply = queryReply;
+
+            if (command == Mp3_Commands_GetVolume)
+            {
+                reply = volume;
+            }
+            else if (command == Mp3_Commands_GetStatus)
+            {
+                reply = status;
+            }
+            if (!isDropped())
+            {
+                inject(command, reply, latency);
+            }
+            return;
+        }
+
+        if (command == rejected)
+        {
+            inject(Mp3_Replies_Error, rejectError, latency);
+            return;
+        }
+        if (command == Mp3_Commands_SetVolume)
+        {
+            volume = arg;
+        }
+        if (requestAck && isAcking && !isDropped())
+        {
+            inject(Mp3_Replies_Ack, 0, latency);
+        }
+    }
+};
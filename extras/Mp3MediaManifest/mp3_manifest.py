@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Generate a header of named DfMp3_Clip constants from an SD card image.
+
+The directory is expected to be laid out the way DFMiniMp3 plays it:
+
+    ##/###name.mp3    playFolderTrack()      folders 01-99, tracks 001-255
+    ##/####name.mp3   playFolderTrack16()    folders 01-15, tracks 0001-3000
+    mp3/####name.mp3  playMp3FolderTrack()
+    advert/####name.mp3  playAdvertisement()
+
+Each clip gets a constexpr DfMp3_Clip named after the text following its
+number, with the command argument already encoded, so the sketch plays
+clips by name and regenerating the header follows the card as it changes.
+
+The header also holds Mp3MediaHash and the list of numbered folders, so
+at boot the sketch can check the card matches what it was built for:
+
+    dfmp3.verifyMediaHash(Mp3MediaHash, Mp3MediaFolders, Mp3MediaFolderCount);
+
+usage: mp3_manifest.py SD_DIRECTORY [-o Mp3Media.h] [--prefix Mp3Clip_]
+"""
+
+import argparse
+import os
+import re
+import sys
+
+AUDIO_EXTENSIONS = ('.mp3', '.wav', '.wma')
+
+KIND_FOLDER = 'DfMp3_ClipKind_Folder'
+KIND_FOLDER16 = 'DfMp3_ClipKind_Folder16'
+KIND_MP3 = 'DfMp3_ClipKind_Mp3'
+KIND_ADVERT = 'DfMp3_ClipKind_Advert'
+
+FNV_SEED = 2166136261
+FNV_PRIME = 16777619
+
+
+class Clip:
+    def __init__(self, kind, arg, tag, number, label, path):
+        self.kind = kind
+        self.arg = arg
+        self.tag = tag  # folder the clip is in, for names and comments
+        self.number = number
+        self.label = label  # text after the track number
+        self.path = path
+        self.name = None
+
+
+def warn(message):
+    print('warning: ' + message, file=sys.stderr)
+
+
+def is_audio(file_name):
+    return (not file_name.startswith('.') and
+            file_name.lower().endswith(AUDIO_EXTENSIONS))
+
+
+def audio_files(directory):
+    return sorted(name for name in os.listdir(directory)
+                  if is_audio(name) and os.path.isfile(os.path.join(directory, name)))
+
+
+def split_track(file_name, digits):
+    match = re.match(r'^(\d{%d})(?!\d)(.*)$' % digits, os.path.splitext(file_name)[0])
+    if not match:
+        return None, None
+    return int(match.group(1)), match.group(2)
+
+
+def identifier(label):
+    words = re.findall(r'[A-Za-z0-9]+', label)
+    return ''.join(word[0].upper() + word[1:] for word in words)
+
+
+def hash_add(value, hash_value):
+    for byte in (value & 0xff, (value >> 8) & 0xff):
+        hash_value = ((hash_value ^ byte) * FNV_PRIME) & 0xffffffff
+    return hash_value
+
+
+def scan_numbered_folder(root, folder_name, clips):
+    folder = int(folder_name)
+    directory = os.path.join(root, folder_name)
+    tag = 'F%02d' % folder
+
+    for file_name in audio_files(directory):
+        path = folder_name + '/' + file_name
+        track, label = split_track(file_name, 4)
+        if track is not None:
+            if folder > 15 or track < 1 or track > 3000:
+                warn('%s is out of range for playFolderTrack16()' % path)
+                continue
+            clips.append(Clip(KIND_FOLDER16, (folder << 12) | track, tag, track, label, path))
+            continue
+
+        track, label = split_track(file_name, 3)
+        if track is None or track < 1 or track > 255:
+            warn('%s is not a ###/#### track, skipped' % path)
+            continue
+        clips.append(Clip(KIND_FOLDER, (folder << 8) | track, tag, track, label, path))
+
+
+def scan_track_folder(root, folder_name, kind, tag, clips):
+    directory = os.path.join(root, folder_name)
+
+    for file_name in audio_files(directory):
+        path = folder_name + '/' + file_name
+        track, label = split_track(file_name, 4)
+        if track is None:
+            warn('%s is not a #### track, skipped' % path)
+            continue
+        clips.append(Clip(kind, track, tag, track, label, path))
+
+
+def count_audio(root):
+    # the module counts every audio file on the media for its total
+    total = 0
+    for directory, dirs, files in os.walk(root):
+        dirs[:] = [name for name in dirs if not name.startswith('.')]
+        total += sum(1 for name in files if is_audio(name))
+    return total
+
+
+def scan(root):
+    clips = []
+    folders = []
+
+    for entry in sorted(os.listdir(root)):
+        if not os.path.isdir(os.path.join(root, entry)):
+            continue
+        if re.match(r'^\d{2}$', entry) and 1 <= int(entry) <= 99:
+            folders.append((int(entry), len(audio_files(os.path.join(root, entry)))))
+            scan_numbered_folder(root, entry, clips)
+        elif entry.lower() == 'mp3':
+            scan_track_folder(root, entry, KIND_MP3, 'Mp3', clips)
+        elif entry.lower() == 'advert':
+            scan_track_folder(root, entry, KIND_ADVERT, 'Advert', clips)
+
+    media_hash = hash_add(count_audio(root), FNV_SEED)
+    for folder, count in folders:
+        media_hash = hash_add(count, hash_add(folder, media_hash))
+
+    return clips, [folder for folder, _ in folders], media_hash
+
+
+def assign_names(clips, prefix):
+    # the label alone when it is unique, then qualified by the folder,
+    # then by the track number, then numbered until it is unique
+    labels = {}
+    for clip in clips:
+        labels.setdefault(identifier(clip.label), []).append(clip)
+
+    used = set()
+    for clip in clips:
+        label = identifier(clip.label)
+        candidates = []
+        if label and len(labels[label]) == 1:
+            candidates.append(label)
+        if label:
+            candidates.append('%s_%s' % (clip.tag, label))
+        candidates.append('%s_%04d' % (clip.tag, clip.number))
+
+        for candidate in candidates:
+            if candidate not in used:
+                break
+        else:
+            base = candidates[-1]
+            suffix = 2
+            candidate = '%s_%d' % (base, suffix)
+            while candidate in used:
+                suffix += 1
+                candidate = '%s_%d' % (base, suffix)
+        used.add(candidate)
+        clip.name = prefix + candidate
+
+
+def write_header(out, source, clips, folders, media_hash):
+    out.write('// generated by extras/Mp3MediaManifest/mp3_manifest.py from %s\n' % source)
+    out.write('// do not edit, run it again when the media changes\n')
+    out.write('#pragma once\n\n')
+    out.write('#include <DFMiniMp3.h>\n\n')
+    out.write('const uint32_t Mp3MediaHash = 0x%08xUL;\n' % media_hash)
+    out.write('const uint8_t Mp3MediaFolderCount = %d;\n' % len(folders))
+    out.write('static const uint8_t Mp3MediaFolders[] Mp3_ProgMem = { %s };\n\n' %
+              ', '.join(str(folder) for folder in (folders or [0])))
+
+    for clip in clips:
+        out.write('// %s\n' % clip.path)
+        out.write('constexpr DfMp3_Clip %s = { %s, 0x%04x };\n' % (clip.name, clip.kind, clip.arg))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate DfMp3_Clip constants from an SD card image.')
+    parser.add_argument('root', help='directory holding the SD card contents')
+    parser.add_argument('-o', '--output', help='header to write, stdout when not given')
+    parser.add_argument('--prefix', default='Mp3Clip_', help='prefix of the clip names')
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.root):
+        parser.error('%s is not a directory' % args.root)
+
+    clips, folders, media_hash = scan(args.root)
+    assign_names(clips, args.prefix)
+    source = os.path.basename(os.path.normpath(args.root))
+
+    if args.output:
+        with open(args.output, 'w', newline='\n') as out:
+            write_header(out, source, clips, folders, media_hash)
+    else:
+        write_header(sys.stdout, source, clips, folders, media_hash)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
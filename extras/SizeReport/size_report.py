@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""Build representative DFMiniMp3 sketches and report their footprint.
+
+Each configuration is a chip variant combined with a profile of the
+compile out flags.  Each is built with arduino-cli for the board, the
+default is an ATmega328 Uno.  For every build the report records the
+.text, .data and .bss sizes of the whole sketch and sizeof(DFMiniMp3<...>).
+
+    size_report.py                          print the report
+    size_report.py -o sizes.json            also save it
+    size_report.py --baseline sizes.json    fail if anything grew, or if
+                                            minimal is above the default
+                                            of the baseline
+
+Needs arduino-cli with the core of the board installed, and the avr-size
+and avr-nm (or matching) tools of that core on the path.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+LIBRARY = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+
+CHIPS = [
+    'Mp3ChipOriginal',
+    'Mp3ChipMH2024K16SS',
+    'Mp3ChipIncongruousNoAck',
+]
+
+PROFILES = {
+    'default': [],
+    'fixedQueue': ['DfMiniMp3NotificationQueue 4'],
+    'minimal': [
+        'DfMiniMp3NoNotifications',
+        'DfMiniMp3NoQueries',
+        'DfMiniMp3NoRetries',
+        'DfMiniMp3NoStateTracking',
+    ],
+}
+
+SKETCH = '''// generated by extras/SizeReport/size_report.py
+{defines}
+#include <DFMiniMp3.h>
+
+class Mp3Notify
+{{
+public:
+    template <class T> static void OnError(T&, uint16_t) {{}}
+    template <class T> static void OnPlayFinished(T&, DfMp3_PlaySources, uint16_t) {{}}
+    template <class T> static void OnPlaySourceOnline(T&, DfMp3_PlaySources) {{}}
+    template <class T> static void OnPlaySourceInserted(T&, DfMp3_PlaySources) {{}}
+    template <class T> static void OnPlaySourceRemoved(T&, DfMp3_PlaySources) {{}}
+}};
+
+typedef DFMiniMp3<HardwareSerial, Mp3Notify, {chip}> DfMp3;
+
+DfMp3 dfmp3(Serial);
+
+// its symbol size is sizeof(DfMp3)
+extern const uint8_t DfMp3SizeProbe[sizeof(DfMp3)];
+__attribute__((used)) const uint8_t DfMp3SizeProbe[sizeof(DfMp3)] = {{}};
+
+void setup()
+{{
+    dfmp3.begin();
+    dfmp3.setVolume(20);
+    dfmp3.playMp3FolderTrack(1);
+{queries}
+}}
+
+void loop()
+{{
+    dfmp3.loop();
+}}
+'''
+
+QUERIES = '''    if (dfmp3.getTotalTrackCount() == 0)
+    {
+        dfmp3.stop();
+    }'''
+
+
+def run(command):
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stdout)
+        raise SystemExit('failed: ' + ' '.join(command))
+    return result.stdout
+
+
+def write_sketch(directory, chip, flags):
+    name = os.path.basename(directory)
+    defines = '\n'.join('#define ' + flag for flag in flags)
+    queries = '' if 'DfMiniMp3NoQueries' in flags else QUERIES
+    with open(os.path.join(directory, name + '.ino'), 'w') as sketch:
+        sketch.write(SKETCH.format(defines=defines, chip=chip, queries=queries))
+
+
+def find_elf(build):
+    for name in os.listdir(build):
+        if name.endswith('.elf'):
+            return os.path.join(build, name)
+    raise SystemExit('no elf in ' + build)
+
+
+def measure(elf, tools):
+    # berkeley format, the second line is text data bss dec hex filename
+    sizes = run([tools + 'size', elf]).splitlines()[1].split()
+    probe = 0
+    for line in run([tools + 'nm', '-S', elf]).splitlines():
+        fields = line.split()
+        if len(fields) == 4 and fields[3] == 'DfMp3SizeProbe':
+            probe = int(fields[1], 16)
+    return {'text': int(sizes[0]), 'data': int(sizes[1]), 'bss': int(sizes[2]), 'sizeof': probe}
+
+
+def build_all(fqbn, tools):
+    report = {}
+    work = tempfile.mkdtemp(prefix='dfmp3size')
+    try:
+        for chip in CHIPS:
+            for profile, flags in PROFILES.items():
+                key = chip + '/' + profile
+                sketch = os.path.join(work, 'Size_' + chip + '_' + profile)
+                build = os.path.join(sketch, 'build')
+                os.makedirs(build)
+                write_sketch(sketch, chip, flags)
+                run(['arduino-cli', 'compile', '--fqbn', fqbn, '--library', LIBRARY,
+                     '--build-path', build, sketch])
+                report[key] = measure(find_elf(build), tools)
+                print('%-40s text %6d data %5d bss %5d sizeof %4d' % (
+                    key, report[key]['text'], report[key]['data'],
+                    report[key]['bss'], report[key]['sizeof']))
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+    return report
+
+
+def compare(report, baseline, tolerance):
+    regressions = []
+    for key, sizes in sorted(report.items()):
+        if key not in baseline:
+            continue
+        for field, size in sorted(sizes.items()):
+            before = baseline[key].get(field, size)
+            if size > before + tolerance:
+                regressions.append('%s %s grew from %d to %d' % (key, field, before, size))
+
+    # every feature added since must compile out, back to what
+    # the default was then
+    for chip in CHIPS:
+        minimal = report.get(chip + '/minimal')
+        default = baseline.get(chip + '/default')
+        if minimal is None or default is None:
+            continue
+        print('%-40s sizeof %4d against the baseline default %4d' % (
+            chip + '/minimal', minimal['sizeof'], default['sizeof']))
+        if minimal['sizeof'] > default['sizeof'] + tolerance:
+            regressions.append('%s/minimal sizeof %d is above the baseline default %d' % (
+                chip, minimal['sizeof'], default['sizeof']))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Report the DFMiniMp3 footprint of representative builds.')
+    parser.add_argument('--fqbn', default='arduino:avr:uno', help='board to build for')
+    parser.add_argument('--tools', default='avr-', help='prefix of the size and nm tools')
+    parser.add_argument('-o', '--output', help='save the report as json')
+    parser.add_argument('--baseline', help='json report to compare against')
+    parser.add_argument('--tolerance', type=int, default=0, help='bytes any size may grow by')
+    args = parser.parse_args()
+
+    report = build_all(args.fqbn, args.tools)
+
+    if args.output:
+        with open(args.output, 'w') as output:
+            json.dump(report, output, indent=2, sort_keys=True)
+            output.write('\n')
+
+    if args.baseline:
+        with open(args.baseline) as baseline:
+            regressions = compare(report, json.load(baseline), args.tolerance)
+        for regression in regressions:
+            print('regression: ' + regression)
+        if regressions:
+            return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -26,26 +26,145 @@ License along with DFMiniMp3.  If not, see
 #pragma once
 
 #include "internal/queueSimple.h"
+#include "internal/ringSimple.h"
+#ifdef DfMiniMp3Debug
+#include "internal/Mp3DebugLog.h"
+#endif
+#include "internal/Mp3SpanTracing.h"
 #include "DfMp3Types.h"
 #include "internal/Mp3Packet.h"
+#include "internal/Mp3CommandDescriptors.h"
 #include "Mp3ChipBase.h"
 #include "Mp3ChipOriginal.h"
 #include "Mp3ChipMH2024K16SS.h"
 #include "Mp3ChipIncongruousNoAck.h"
+#include "Mp3ChipAutoDetect.h"
+#include "internal/Mp3LockNone.h"
+#include "Mp3NotificationBus.h"
+#include "Mp3Sequencer.h"
+#include "Mp3Sentence.h"
+#include "Mp3PlaybackWatchdog.h"
+#include "Mp3DualDeck.h"
+#include "Mp3IdleManager.h"
+
+// define DfMiniMp3PendingCommands as a count of actions issued from 
+// within a notification to keep until it returns, rather than nesting 
+// their transaction in the one calling it; when full they are sent 
+// nested, as they are without it, and a query sends them first
+
+// define DfMiniMp3ClipChain as the count of clips playClipChain() 
+// keeps after the first, Mp3Sentence plays through it
+
+// define DfMiniMp3QueryCache as a number of replies kept, for tasks
+// asking the same query at once to share a single round trip, and for 
+// callers passing a maxAge to take a recent enough reply; the round 
+// trip is only shared where the toolchain has <atomic>
+#if defined(DfMiniMp3QueryCache) && !defined(__AVR__) && defined(__has_include)
+#if __has_include(<atomic>)
+#include <atomic>
+#define Mp3_QueryCompletionsAtomic
+#endif
+#endif
+
+// define DfMiniMp3MediaDebounce as a settle time in ms, the online, 
+// inserted and removed reports of a source are held until it has been
+// quiet that long, then only a change from what was last reported is
+// notified, so a loose card is one event rather than a storm
+#ifdef DfMiniMp3NoNotifications
+#undef DfMiniMp3MediaDebounce
+#endif
+
+// define DfMiniMp3PowerManagement to track sleep() and disableDac(), 
+// so any other command wakes the module first, see Mp3IdleManager.h
+
+// define DfMiniMp3Async before including for queueAsync(), commands
+// that loop() carries through without blocking, Mp3Coroutine.h 
+// needs it for its awaitables; requests go out by DfMp3_AsyncLane, 
+// so a stop queued behind a folder scan is the next on the wire
+
+// for small boards, define before including to compile out 
+//   DfMiniMp3NoNotifications - T_NOTIFICATION_METHOD is never called, 
+//       online sources and track finished are still tracked
+//   DfMiniMp3NoQueries - query<>() and getCommand() fail to compile
+//   DfMiniMp3NoRetries - commands are sent once, setComRetries() is removed
+//   DfMiniMp3NotificationQueue - a fixed queue of this many notifications
+//       in place of the queue grown on the heap
+//   DfMiniMp3NoStateTracking - the last play command, expected playback
+//       and online sources are not kept, so snapshots, replayLastPlay()
+//       and Mp3PlaybackWatchdog are removed and a 0x3f is taken as the
+//       reply whenever getPlaySources() waits for one
+// see extras/SizeReport for what each saves
+#if defined(DfMiniMp3NoStateTracking) && \
+    (defined(DfMiniMp3Async) || defined(DfMiniMp3TrackDurations) || defined(DfMiniMp3MediaDebounce))
+#error "DfMiniMp3Async, DfMiniMp3TrackDurations and DfMiniMp3MediaDebounce need what DfMiniMp3NoStateTracking removes"
+#endif
 
 
-template <class T_SERIAL_METHOD, class T_NOTIFICATION_METHOD, class T_CHIP_VARIANT = Mp3ChipOriginal, uint32_t C_ACK_TIMEOUT = 900>
-class DFMiniMp3
+// T_LOCK_POLICY is Mp3LockNone or, with Mp3LockPolicy.h included, one
+// of its classes, it is a private base so Mp3LockNone costs no memory
+template <class T_SERIAL_METHOD, 
+    class T_NOTIFICATION_METHOD, 
+    class T_CHIP_VARIANT = Mp3ChipOriginal, 
+    uint32_t C_ACK_TIMEOUT = 900,
+    class T_LOCK_POLICY = Mp3LockNone>
+class DFMiniMp3 : private T_LOCK_POLICY
 {
 public:
     explicit DFMiniMp3(T_SERIAL_METHOD& serial) :
         _serial(serial),
+#ifndef DfMiniMp3NoRetries
         _comRetries(3), // default to three retries
-        _isOnline(false),
+#endif
+        _isOnline(false)
+#ifndef DfMiniMp3NoStateTracking
+        , _playSources(0)
+        , _transaction()
+        , _lastPlay()
+        , _isPlaybackExpected(false)
+        , _playbackCommanded(0)
+#endif
+#ifdef DfMiniMp3PendingCommands
+        , _notificationDepth(0)
+#endif
+#ifdef DfMiniMp3ClipChain
+        , _clipChainSent(0)
+        , _isClipDue(false)
+#endif
+#ifdef DfMiniMp3Async
+        , _async()
+#endif
+#ifdef DfMiniMp3QueryCache
+        , _sharedQueries()
+        , _queryCompletions(0)
+#endif
+#ifdef DfMiniMp3PowerManagement
+        , _power()
+#endif
+#ifdef DfMiniMp3MediaDebounce
+        , _media()
+#endif
+#ifdef DfMiniMp3TrackDurations
+        , _trackDurations()
+        , _trackKey()
+        , _trackStarted(0)
+        , _trackPaused(0)
+        , _isTrackTimed(false)
+        , _isTrackPaused(false)
+#endif
 #ifdef DfMiniMp3Debug
-        _inTransaction(0),
+        , _inTransaction(0)
+#endif
+#if !defined(DfMiniMp3NoNotifications) && !defined(DfMiniMp3NotificationQueue)
+        , _queueNotifications(4) // default to 4 notifications in queue
+#endif
+#ifdef DfMiniMp3Stats
+        , _receptionStats()
+        , _transactionStats()
+        , _notificationReceived(0)
+        , _clipGapStats()
+        , _trackFinished(0)
+        , _isTrackFinished(false)
 #endif
-        _queueNotifications(4) // default to 4 notifications in queue
     {
     }
 
@@ -59,54 +178,76 @@ public:
         _serial.begin(baud, SERIAL_8N1, rxPin, txPin);
     }
 
+#ifndef DfMiniMp3NoRetries
     void setComRetries(uint8_t retries)
     {
         _comRetries = retries;
     }
+#endif
 
     void loop()
     {
-        // call all outstanding notifications
-        while (abateNotification());
+#ifdef DfMiniMp3Debug
+        printDebugLog();
+#endif
+        LockGuard guard(*this);
 
-        // check for any new notifications in comms
-        uint8_t maxDrains = 6;
+        pumpNotifications();
+        sendNextClip();
+        runPendingCommands();
+#ifdef DfMiniMp3Async
+        runAsync();
+#endif
+    }
 
-        while (maxDrains &&
-            _serial.available() >= static_cast<int>(sizeof(typename T_CHIP_VARIANT::ReceptionPacket)))
-        {
-            listenForReply(Mp3_Commands_None);
-            maxDrains--;
-        }
+#ifdef DfMiniMp3Debug
+    // called by loop(), but may be called from a low priority task instead
+    // so debug output never delays the comms
+    void printDebugLog()
+    {
+        _log.print(DfMiniMp3Debug);
     }
+#endif
 
-    // Does not work with all models.
-    // 0x3f reply overlaps the play source online notification
-    // so this is why I suspect this has been deprecated and should
-    // be avoided as there is not a way to tell a notification from a value return
+    // 0x3f reply overlaps the play source online notification,
+    // so a 0x3f is only taken as the reply when it arrives within the 
+    // chip's reply window after sending, otherwise it is a notification
     // YX5200-24SS - sends reply
-    // MH2024K-24SS - sends NO reply --> results in error notification
-    [[deprecated("Command in conflict with notification with no valid solution.")]]
+    // MH2024K-24SS - sends NO reply --> the sources last reported 
+    //     by online/inserted/removed notifications are returned instead
     DfMp3_PlaySources getPlaySources()
     {
-        return getCommand(Mp3_Commands_GetPlaySources).arg;
+#ifdef DfMiniMp3NoStateTracking
+        return static_cast<DfMp3_PlaySources>(getCommand<Mp3_Commands_GetPlaySources>().arg);
+#else
+        if (T_CHIP_VARIANT::playSourcesReplyWindow() != 0)
+        {
+            reply_t reply = getCommand<Mp3_Commands_GetPlaySources>();
+
+            if (reply.command == Mp3_Commands_GetPlaySources)
+            {
+                _playSources = reply.arg;
+            }
+        }
+        return static_cast<DfMp3_PlaySources>(_playSources);
+#endif
     }
 
     uint16_t getSoftwareVersion()
     {
-        return getCommand(Mp3_Commands_GetSoftwareVersion).arg;
+        return query<Mp3_Command_GetSoftwareVersion>();
     }
 
     // the track as enumerated across all folders
     void playGlobalTrack(uint16_t track = 0)
     {
-        setCommand(Mp3_Commands_PlayGlobalTrack, track);
+        send<Mp3_Command_PlayGlobalTrack>(track);
     }
 
     // sd:/mp3/####track name
     void playMp3FolderTrack(uint16_t track)
     {
-        setCommand(Mp3_Commands_PlayMp3FolderTrack, track);
+        send<Mp3_Command_PlayMp3FolderTrack>(track);
     }
 
     // older devices: sd:/###/###track name
@@ -115,7 +256,7 @@ public:
     void playFolderTrack(uint8_t folder, uint8_t track)
     {
         uint16_t arg = (folder << 8) | track;
-        setCommand(Mp3_Commands_PlayFolderTrack, arg);
+        send<Mp3_Command_PlayFolderTrack>(arg);
     }
 
     // sd:/##/####track name
@@ -123,139 +264,117 @@ public:
     void playFolderTrack16(uint8_t folder, uint16_t track)
     {
         uint16_t arg = (static_cast<uint16_t>(folder) << 12) | track;
-        setCommand(Mp3_Commands_PlayFolderTrack16, arg);
+        send<Mp3_Command_PlayFolderTrack16>(arg);
     }
 
     void playRandomTrackFromAll()
     {
-        setCommand(Mp3_Commands_PlayRandmomGlobalTrack);
+        send<Mp3_Command_PlayRandmomGlobalTrack>();
     }
 
     void nextTrack()
     {
-        setCommand(Mp3_Commands_PlayNextTrack);
+        send<Mp3_Command_PlayNextTrack>();
     }
 
     void prevTrack()
     {
-        setCommand(Mp3_Commands_PlayPrevTrack);
+        send<Mp3_Command_PlayPrevTrack>();
     }
 
     uint16_t getCurrentTrack(DfMp3_PlaySource source = DfMp3_PlaySource_Sd)
     {
-        uint8_t command;
-
-        switch (source)
-        {
-        case DfMp3_PlaySource_Usb:
-            command = Mp3_Commands_GetUsbCurrentTrack;
-            break;
-        case DfMp3_PlaySource_Sd:
-            command = Mp3_Commands_GetSdCurrentTrack;
-            break;
-        case DfMp3_PlaySource_Flash:
-            command = Mp3_Commands_GetFlashCurrentTrack;
-            break;
-        default:
-            command = Mp3_Commands_GetSdCurrentTrack;
-            break;
-        }
-
-        return getCommand(command).arg;
+        return getCommand(Mp3_CommandForSource(Mp3_Commands_GetUsbCurrentTrack, source)).arg;
     }
 
     // 0- 30
     void setVolume(uint8_t volume)
     {
-        setCommand(Mp3_Commands_SetVolume, volume);
+        send<Mp3_Command_SetVolume>(volume);
     }
 
-    uint8_t getVolume()
+    // maxAge in ms, see DfMiniMp3QueryCache
+    uint8_t getVolume(uint32_t maxAge = 0)
     {
-        return getCommand(Mp3_Commands_GetVolume).arg;
+        return query<Mp3_Command_GetVolume>(0, maxAge);
     }
 
     void increaseVolume()
     {
-        setCommand(Mp3_Commands_IncVolume);
+        send<Mp3_Command_IncVolume>();
     }
 
     void decreaseVolume()
     {
-        setCommand(Mp3_Commands_DecVolume);
+        send<Mp3_Command_DecVolume>();
     }
 
     // useless, removed
     // 0-31
-    /*
-    void setVolume(bool mute, uint8_t volume)
-    {
-        uint16_t arg = (!mute << 8) | volume;
-        setCommand(0x10, arg);
-    }
-    */
+    // still reachable with
+    // send<Mp3_Command_SetVolumeMute>((!mute << 8) | volume);
 
     void loopGlobalTrack(uint16_t globalTrack)
     {
-        setCommand(Mp3_Commands_LoopGlobalTrack, globalTrack);
+        send<Mp3_Command_LoopGlobalTrack>(globalTrack);
     }
 
     // sd:/##/*
     // 0-99
     void loopFolder(uint8_t folder)
     {
-        setCommand(Mp3_Commands_LoopInFolder, folder);
+        send<Mp3_Command_LoopInFolder>(folder);
     }
 
     // not well supported, use at your own risk
     void setPlaybackMode(DfMp3_PlaybackMode mode)
     {
-        setCommand(Mp3_Commands_SetPlaybackMode, mode);
+        send<Mp3_Command_SetPlaybackMode>(mode);
     }
 
     DfMp3_PlaybackMode getPlaybackMode()
     {
-        return static_cast<DfMp3_PlaybackMode>(getCommand(Mp3_Commands_GetPlaybackMode).arg);
+        return query<Mp3_Command_GetPlaybackMode>();
     }
 
     void setRepeatPlayAllInRoot(bool repeat)
     {
-        setCommand(Mp3_Commands_RepeatPlayInRoot, !!repeat);
+        send<Mp3_Command_RepeatPlayInRoot>(!!repeat);
     }
 
     void setRepeatPlayCurrentTrack(bool repeat)
     {
-        setCommand(Mp3_Commands_RepeatPlayCurrentTrack, !repeat);
+        send<Mp3_Command_RepeatPlayCurrentTrack>(!repeat);
     }
 
     void setEq(DfMp3_Eq eq)
     {
-        setCommand(Mp3_Commands_SetEq, eq);
+        send<Mp3_Command_SetEq>(eq);
     }
 
     DfMp3_Eq getEq()
     {
-        return static_cast<DfMp3_Eq>(getCommand(Mp3_Commands_GetEq).arg);
+        return query<Mp3_Command_GetEq>();
     }
 
     void setPlaybackSource(DfMp3_PlaySource source)
     {
-        setCommand(Mp3_Commands_SetPlaybackSource, source);
+        send<Mp3_Command_SetPlaybackSource>(source);
     }
 
     void sleep()
     {
-        setCommand(Mp3_Commands_Sleep);
+        send<Mp3_Command_Sleep>();
     }
 
     void awake()
     {
-        setCommand(Mp3_Commands_Awake);
+        send<Mp3_Command_Awake>();
     }
 
     void reset(bool waitForOnline = true)
     {
-        setCommand(Mp3_Commands_Reset);
+        send<Mp3_Command_Reset>();
 
         _isOnline = false;
         while (waitForOnline && !_isOnline)
@@ -267,288 +386,2144 @@ public:
 
     void start()
     {
-        setCommand(Mp3_Commands_Start);
+        send<Mp3_Command_Start>();
     }
 
     void pause()
     {
-        setCommand(Mp3_Commands_Pause);
+        send<Mp3_Command_Pause>();
     }
 
     void stop()
     {
-        setCommand(Mp3_Commands_Stop);
+        send<Mp3_Command_Stop>();
     }
 
-    DfMp3_Status getStatus()
+#ifdef DfMiniMp3MediaDebounce
+    void setMediaSettleTime(uint16_t settleTime)
     {
-        uint16_t reply = getCommand(Mp3_Commands_GetStatus).arg;
+        _media.settleTime = settleTime;
+    }
 
-        DfMp3_Status status;
-        status.source = static_cast<DfMp3_StatusSource>(reply >> 8);
-        status.state = static_cast<DfMp3_StatusState>(reply & 0xff);
+    const DfMp3_MediaStats& getMediaStats() const
+    {
+        return _media.stats;
+    }
 
-        return status;
+    void resetMediaStats()
+    {
+        _media.stats = {};
     }
+#endif
 
-    uint16_t getFolderTrackCount(uint16_t folder)
+#ifdef DfMiniMp3PowerManagement
+    bool isSleeping() const
     {
-        return getCommand(Mp3_Commands_GetFolderTrackCount, folder).arg;
+        return _power.isSleeping;
     }
 
-    uint16_t getTotalTrackCount(DfMp3_PlaySource source = DfMp3_PlaySource_Sd)
+    // millis() of the last command sent other than those of sleep and the dac
+    uint32_t getLastActivity() const
     {
-        uint8_t command;
+        return _power.lastActivity;
+    }
 
-        switch (source)
-        {
-        case DfMp3_PlaySource_Usb:
-            command = Mp3_Commands_GetUsbTrackCount;
-            break;
-        case DfMp3_PlaySource_Sd:
-            command = Mp3_Commands_GetSdTrackCount;
-            break;
-        case DfMp3_PlaySource_Flash:
-            command = Mp3_Commands_GetFlashTrackCount;
-            break;
-        default:
-            command = Mp3_Commands_GetSdTrackCount;
-            break;
-        }
+    // awake() and enableDac() as needed, done ahead of any 
+    // other command sent while asleep
+    void wake()
+    {
+        LockGuard guard(*this);
 
-        return getCommand(command).arg;
+        wakeFor(Mp3_Commands_None);
     }
 
-    uint16_t getTotalFolderCount()
+    const DfMp3_PowerStats& getPowerStats() const
     {
-        return getCommand(Mp3_Commands_GetTotalFolderCount).arg;
+        return _power.stats;
     }
 
-    // sd:/advert/####track name
-    void playAdvertisement(uint16_t track)
+    void resetPowerStats()
     {
-        setCommand(Mp3_Commands_PlayAdvertTrack, track);
+        _power.stats = {};
     }
 
-    void stopAdvertisement()
+    // ms asleep, including a sleep in progress
+    uint32_t getSleepTime() const
     {
-        setCommand(Mp3_Commands_StopAdvert);
+        return _power.stats.sleepTime + (_power.isSleeping ? (millis() - _power.slept) : 0);
     }
+#endif
 
-    void enableDac()
+#ifndef DfMiniMp3NoStateTracking
+    // true from a play or start command until a stop, pause, sleep,
+    // reset or the track finishing, for playback watchdogs
+    bool isPlaybackExpected() const
     {
-        setCommand(Mp3_Commands_SetDacInactive, 0x00);
+        return _isPlaybackExpected;
     }
 
-    void disableDac()
+    // millis() of the command that last started playback
+    uint32_t getPlaybackCommanded() const
     {
-        setCommand(Mp3_Commands_SetDacInactive, 0x01);
+        return _playbackCommanded;
     }
 
-    bool isOnline() const
+    // sends what was last asked to play again, false when nothing was
+    bool replayLastPlay()
     {
-        return _isOnline;
+        if (_lastPlay.command == Mp3_Commands_None)
+        {
+            return false;
+        }
+        sendCommand(_lastPlay.command, _lastPlay.arg);
+        return true;
     }
 
-private:
-    struct reply_t
+    // queries the module for what would be needed again after a restart
+    void captureSnapshot(DfMp3_Snapshot* snapshot, DfMp3_PlaySource source = DfMp3_PlaySource_Sd)
     {
-        uint8_t command = 0;
-        uint16_t arg = 0;
+        snapshot->version = DfMp3_SnapshotVersion;
+        snapshot->size = sizeof(DfMp3_Snapshot);
+        snapshot->volume = getVolume();
+        snapshot->eq = getEq();
+        snapshot->playbackMode = getPlaybackMode();
+        snapshot->playSource = source;
+        snapshot->playSources = _playSources;
+        snapshot->playCommand = _lastPlay.command;
+        snapshot->playArg = _lastPlay.arg;
+        snapshot->totalTrackCount = getTotalTrackCount(source);
+        snapshot->totalFolderCount = getTotalFolderCount();
+        snapshot->crc = DfMp3_SnapshotCrc(*snapshot);
+    }
 
-        bool isUndefined()
+    // checks the snapshot is intact and the media is the same with two
+    // queries, then takes on its state so replayLastPlay() resumes;
+    // with reapply the volume and eq are sent as the module may have 
+    // restarted too
+    DfMp3_SnapshotResult restoreSnapshot(const DfMp3_Snapshot& snapshot, bool reapply = true)
+    {
+        if (snapshot.version != DfMp3_SnapshotVersion ||
+            snapshot.size != sizeof(DfMp3_Snapshot) ||
+            snapshot.crc != DfMp3_SnapshotCrc(snapshot))
         {
-            return (command == Mp3_Commands_None);
+            return DfMp3_SnapshotResult_Invalid;
         }
 
-#ifdef DfMiniMp3Debug
-        void printReply() const
-        {
-            char formated[8];
+        DfMp3_PlaySource source = static_cast<DfMp3_PlaySource>(snapshot.playSource);
 
-            sprintf(formated, " %02x", command);
-            DfMiniMp3Debug.print(formated);
-            sprintf(formated, " %04x", arg);
-            DfMiniMp3Debug.print(formated);
+        if (getTotalTrackCount(source) != snapshot.totalTrackCount ||
+            getTotalFolderCount() != snapshot.totalFolderCount)
+        {
+            return DfMp3_SnapshotResult_MediaChanged;
         }
-#endif
-    };
 
-    const uint32_t c_AckTimeout = C_ACK_TIMEOUT;
-    const uint32_t c_NoAckTimeout = 50; // 30ms observerd, added a little overhead
+        _lastPlay.command = snapshot.playCommand;
+        _lastPlay.arg = snapshot.playArg;
+        if (_playSources == 0)
+        {
+            _playSources = snapshot.playSources;
+        }
 
-    T_SERIAL_METHOD& _serial;
-    uint8_t _comRetries;
-    volatile bool _isOnline;
-#ifdef DfMiniMp3Debug
-    int8_t _inTransaction;
-#endif
-    queueSimple_t<reply_t> _queueNotifications;
+        if (reapply)
+        {
+            setVolume(snapshot.volume);
+            setEq(static_cast<DfMp3_Eq>(snapshot.eq));
+        }
+        return DfMp3_SnapshotResult_Restored;
+    }
 
-    void appendNotification(reply_t reply)
+    bool saveSnapshot(DfMp3_SnapshotWrite write, 
+            void* context = nullptr, 
+            DfMp3_PlaySource source = DfMp3_PlaySource_Sd)
     {
-        // store the notification for later calling so
-        // current comms transactions can be finished
-        // without interruption
-        _queueNotifications.Enqueue(reply);
+        DfMp3_Snapshot snapshot;
+
+        captureSnapshot(&snapshot, source);
+        return write(reinterpret_cast<const uint8_t*>(&snapshot), sizeof(snapshot), context);
     }
 
-    bool abateNotification()
+    // snapshot is left with what was read, for the sketch to resume from
+    DfMp3_SnapshotResult loadSnapshot(DfMp3_SnapshotRead read, 
+            DfMp3_Snapshot* snapshot, 
+            void* context = nullptr, 
+            bool reapply = true)
     {
-        // remove the first notification and call it
-        reply_t reply;
-        bool wasAbated = false;
-        if (_queueNotifications.Dequeue(&reply))
+        if (!read(reinterpret_cast<uint8_t*>(snapshot), sizeof(DfMp3_Snapshot), context))
         {
-            callNotification(reply);
-            wasAbated = true;
+            return DfMp3_SnapshotResult_NotFound;
         }
-        return wasAbated;
+        return restoreSnapshot(*snapshot, reapply);
     }
+#endif
 
-    void callNotification(reply_t reply)
+    // maxAge in ms, see DfMiniMp3QueryCache
+    DfMp3_Status getStatus(uint32_t maxAge = 0)
     {
-        switch (reply.command)
-        {
-        case Mp3_Replies_TrackFinished_Usb: // usb
-            T_NOTIFICATION_METHOD::OnPlayFinished(*this, DfMp3_PlaySources_Usb, reply.arg);
-            break;
+        return query<Mp3_Command_GetStatus>(0, maxAge);
+    }
 
-        case Mp3_Replies_TrackFinished_Sd: // micro sd
-            T_NOTIFICATION_METHOD::OnPlayFinished(*this, DfMp3_PlaySources_Sd, reply.arg);
-            break;
+    uint16_t getFolderTrackCount(uint16_t folder)
+    {
+        return query<Mp3_Command_GetFolderTrackCount>(folder);
+    }
 
-        case Mp3_Replies_TrackFinished_Flash: // flash
-            T_NOTIFICATION_METHOD::OnPlayFinished(*this, DfMp3_PlaySources_Flash, reply.arg);
-            break;
+    uint16_t getTotalTrackCount(DfMp3_PlaySource source = DfMp3_PlaySource_Sd)
+    {
+        return getCommand(Mp3_CommandForSource(Mp3_Commands_GetUsbTrackCount, source)).arg;
+    }
 
-        case Mp3_Replies_PlaySource_Online:
-            T_NOTIFICATION_METHOD::OnPlaySourceOnline(*this, static_cast<DfMp3_PlaySources>(reply.arg));
-            break;
+    uint16_t getTotalFolderCount()
+    {
+        return query<Mp3_Command_GetTotalFolderCount>();
+    }
 
-        case Mp3_Replies_PlaySource_Inserted:
-            T_NOTIFICATION_METHOD::OnPlaySourceInserted(*this, static_cast<DfMp3_PlaySources>(reply.arg));
+    // sd:/advert/####track name
+    void playAdvertisement(uint16_t track)
+    {
+        send<Mp3_Command_PlayAdvertTrack>(track);
+    }
+
+    void stopAdvertisement()
+    {
+        send<Mp3_Command_StopAdvert>();
+    }
+
+    void playClip(const DfMp3_Clip& clip)
+    {
+        switch (clip.kind)
+        {
+        case DfMp3_ClipKind_Folder:
+            send<Mp3_Command_PlayFolderTrack>(clip.arg);
             break;
 
-        case Mp3_Replies_PlaySource_Removed:
-            T_NOTIFICATION_METHOD::OnPlaySourceRemoved(*this, static_cast<DfMp3_PlaySources>(reply.arg));
+        case DfMp3_ClipKind_Folder16:
+            send<Mp3_Command_PlayFolderTrack16>(clip.arg);
             break;
 
-        case Mp3_Replies_Error: // error
-            T_NOTIFICATION_METHOD::OnError(*this, reply.arg);
+        case DfMp3_ClipKind_Mp3:
+            send<Mp3_Command_PlayMp3FolderTrack>(clip.arg);
             break;
 
-        default:
-#ifdef DfMiniMp3Debug
-            DfMiniMp3Debug.print("INVALID NOTIFICATION: ");
-            reply.printReply();
-            DfMiniMp3Debug.println();
-#endif
+        case DfMp3_ClipKind_Advert:
+            send<Mp3_Command_PlayAdvertTrack>(clip.arg);
             break;
         }
     }
 
-    void drainResponses()
+    // true when the media matches the manifest generated for it by
+    // extras/Mp3MediaManifest, only the total and the listed folders
+    // are queried; folders may be in flash (Mp3_ProgMem)
+    bool verifyMediaHash(uint32_t hash, 
+            const uint8_t* folders, 
+            uint8_t folderCount, 
+            DfMp3_PlaySource source = DfMp3_PlaySource_Sd)
     {
-        loop();
+        uint32_t media = DfMp3_MediaHashAdd(DfMp3_MediaHashSeed, getTotalTrackCount(source));
+
+        for (uint8_t index = 0; index < folderCount; index++)
+        {
+            uint8_t folder = Mp3_ProgMemReadByte(folders + index);
+
+            media = DfMp3_MediaHashAdd(media, folder);
+            media = DfMp3_MediaHashAdd(media, getFolderTrackCount(folder));
+        }
+        return (media == hash);
     }
 
-    void sendPacket(uint8_t command, uint16_t arg = 0, bool requestAck = false)
+#ifdef DfMiniMp3ClipChain
+    // plays sd:/mp3/#### clips one after the other, the rest of the 
+    // clips are staged and each is sent by the next loop() after the 
+    // previous one is read as finished, before its notification;
+    // returns false if not all of them fit in DfMiniMp3ClipChain
+    bool playClipChain(const uint16_t* clips, uint8_t count)
     {
-        typename T_CHIP_VARIANT::SendPacket packet = T_CHIP_VARIANT::generatePacket(command, arg, requestAck);
+        LockGuard guard(*this);
+        bool isStaged = true;
 
-#ifdef DfMiniMp3Debug
-        DfMiniMp3Debug.print("OUT ");
-        printRawPacket(reinterpret_cast<const uint8_t*>(&packet), sizeof(packet));
-        DfMiniMp3Debug.println();
-#endif
+        _clipChain.Clear();
+        _isClipDue = false;
+        if (count == 0)
+        {
+            return isStaged;
+        }
 
-        _serial.write(reinterpret_cast<uint8_t*>(&packet), sizeof(packet));
+        for (uint8_t clip = 1; clip < count && isStaged; clip++)
+        {
+            isStaged = _clipChain.Enqueue(clips[clip]);
+        }
+
+        _clipChainSent = millis();
+        playMp3FolderTrack(clips[0]);
+        return isStaged;
     }
 
-    bool readPacket(reply_t* reply)
+    // the playing clip continues, the staged ones are dropped
+    void stopClipChain()
     {
-        typename T_CHIP_VARIANT::ReceptionPacket in;
-        uint8_t read;
+        LockGuard guard(*this);
 
-        // init our out args always
-        *reply = {};
+        _clipChain.Clear();
+        _isClipDue = false;
+    }
 
-        // try to sync our reads to the packet start
-        do
-        {
-            // we use readBytes as it gives us the standard timeout
-            read = _serial.readBytes(&in.startCode, 1);
+    uint8_t getClipChainRemaining() const
+    {
+        return _clipChain.Count();
+    }
+#endif
 
-            if (read != 1)
-            {
-                // nothing read
-                reply->arg = DfMp3_Error_RxTimeout;
+    void enableDac()
+    {
+        send<Mp3_Command_SetDacInactive>(0x00);
+    }
 
-                return false;
-            }
-        } while (in.startCode != 0x7e);
+    void disableDac()
+    {
+        send<Mp3_Command_SetDacInactive>(0x01);
+    }
 
-        read += _serial.readBytes(&in.version, sizeof(in) - 1);
+    bool isOnline() const
+    {
+        return _isOnline;
+    }
 
-#ifdef DfMiniMp3Debug
-        DfMiniMp3Debug.print("IN ");
-        printRawPacket(reinterpret_cast<const uint8_t*>(&in), read);
-        DfMiniMp3Debug.println();
-#endif
+    // typed access to any command in Mp3CommandDescriptors.h,
+    // including those without a method of their own
+    template <class T_COMMAND> void send(uint16_t arg = 0)
+    {
+        static_assert(!T_COMMAND::IsQuery, "use query<>() for a command with a reply");
 
-        if (read < sizeof(in))
+        if (T_COMMAND::IsNoAck)
         {
-            // not enough bytes, corrupted packet
-            reply->arg = DfMp3_Error_PacketSize;
-            return false;
+            sendOnly<T_COMMAND::Command>(arg);
         }
-
-        if (in.version != 0xFF ||
-            in.length != 0x06 ||
-            in.endCode != 0xef)
+        else
         {
-            // invalid version or corrupted packet
-            reply->arg = DfMp3_Error_PacketHeader;
-            return false;
+            setCommand<T_COMMAND::Command>(arg);
         }
+    }
+
+    // with DfMiniMp3QueryCache, a reply up to maxAge ms old may be 
+    // given rather than asking again; without, maxAge is ignored
+    template <class T_COMMAND> typename T_COMMAND::Result query(uint16_t arg = 0, uint32_t maxAge = 0)
+    {
+        static_assert(T_COMMAND::IsQuery, "use send<>() for a command without a reply");
+#ifdef DfMiniMp3NoQueries
+        static_assert(!T_COMMAND::IsQuery, "queries are compiled out by DfMiniMp3NoQueries");
+#endif
+
+        return T_COMMAND::decode(getCommand<T_COMMAND::Command>(arg, maxAge, T_COMMAND::IsCacheable).arg);
+    }
+
+    // as query<>() but tells a reply apart from a timeout or an error,
+    // result is only set when the module replied to the query
+    template <class T_COMMAND> bool tryQuery(typename T_COMMAND::Result* result, 
+            uint16_t arg = 0, 
+            uint32_t maxAge = 0)
+    {
+        static_assert(T_COMMAND::IsQuery, "use send<>() for a command without a reply");
+#ifdef DfMiniMp3NoQueries
+        static_assert(!T_COMMAND::IsQuery, "queries are compiled out by DfMiniMp3NoQueries");
+#endif
+
+        reply_t reply = getCommand<T_COMMAND::Command>(arg, maxAge, T_COMMAND::IsCacheable);
 
-        if (!T_CHIP_VARIANT::validateChecksum(in))
+        if (reply.command != T_COMMAND::Command)
         {
-            // checksum failed, corrupted packet
-            reply->arg = DfMp3_Error_PacketChecksum;
             return false;
         }
+        *result = T_COMMAND::decode(reply.arg);
+        return true;
+    }
 
-        reply->command = in.command;
-        reply->arg = ((static_cast<uint16_t>(in.hiByteArgument) << 8) | in.lowByteArgument);
+    // raw access for commands not described, 
+    // returns the reply argument, zero if none
+    uint16_t queryCommand(uint8_t command, uint16_t arg = 0)
+    {
+        return getCommand(command, arg).arg;
+    }
 
-        return true;
+    void sendCommand(uint8_t command, uint16_t arg = 0)
+    {
+        setCommand(command, arg);
     }
 
-    reply_t retryCommand(uint8_t command, 
-            uint8_t expectedCommand, 
-            uint16_t arg = 0, 
-            bool requestAck = false)
+#ifdef DfMiniMp3Async
+    // the command is sent by loop() once those queued before it in its
+    // lane and the lanes above are done, and complete is called from 
+    // loop() when its ack or reply is read, retried and timed out as 
+    // the blocking calls are;
+    // the request must stay valid until then, and blocking calls made
+    // meanwhile wait for the request on the wire first
+    void queueAsync(DfMp3_AsyncRequest* request, DfMp3_AsyncLane lane = DfMp3_AsyncLane_Auto)
     {
-        reply_t reply;
-        uint8_t retries = _comRetries;
+        LockGuard guard(*this);
+
+        request->status = DfMp3_AsyncStatus_Queued;
+        request->lane = (lane == DfMp3_AsyncLane_Auto) ? 
+            laneForCommand(request->command, request->flags) : 
+            lane;
+        request->result = 0;
+        insertAsync(request);
+    }
 
+    template <class T_COMMAND> void queueAsync(DfMp3_AsyncRequest* request, 
+        uint16_t arg = 0, 
+        DfMp3_AsyncLane lane = DfMp3_AsyncLane_Auto)
+    {
+#ifdef DfMiniMp3NoQueries
+        static_assert(!T_COMMAND::IsQuery, "queries are compiled out by DfMiniMp3NoQueries");
+#endif
+        request->command = T_COMMAND::Command;
+        request->flags = T_COMMAND::Flags;
+        request->arg = arg;
+        queueAsync(request, lane);
+    }
 
-#ifdef DfMiniMp3Debug
-        if (_inTransaction != 0)
+    // removes a request not yet sent, false once it is on the wire
+    bool cancelAsync(DfMp3_AsyncRequest* request)
+    {
+        LockGuard guard(*this);
+        DfMp3_AsyncRequest* previous = nullptr;
+        DfMp3_AsyncRequest* queued = _async.head;
+
+        while (queued && queued != request)
         {
-            DfMiniMp3Debug.print("Rentrant? _inTransaction ");
-            DfMiniMp3Debug.print(_inTransaction);
+            previous = queued;
+            queued = queued->next;
         }
-        else
-#endif
+
+        if (!queued || queued->status != DfMp3_AsyncStatus_Queued)
         {
-            drainResponses();
+            return false;
+        }
+
+        if (previous)
+        {
+            previous->next = request->next;
+        }
+        else
+        {
+            _async.head = request->next;
+        }
+        if (_async.tail == request)
+        {
+            _async.tail = previous;
+        }
+        request->next = nullptr;
+        request->status = DfMp3_AsyncStatus_Idle;
+        return true;
+    }
+
+    // removes the requests of the lane not yet sent, they complete 
+    // from loop() as DfMp3_AsyncStatus_Cancelled, returns how many
+    uint8_t cancelAsync(DfMp3_AsyncLane lane)
+    {
+        LockGuard guard(*this);
+        DfMp3_AsyncRequest* previous = nullptr;
+        DfMp3_AsyncRequest* queued = _async.head;
+        DfMp3_AsyncRequest** cancelled = &_async.cancelled;
+        uint8_t count = 0;
+
+        // completed in the order they were queued
+        while (*cancelled)
+        {
+            cancelled = &(*cancelled)->next;
+        }
+
+        while (queued)
+        {
+            DfMp3_AsyncRequest* next = queued->next;
+
+            if (queued->lane == lane && queued->status == DfMp3_AsyncStatus_Queued)
+            {
+                if (previous)
+                {
+                    previous->next = next;
+                }
+                else
+                {
+                    _async.head = next;
+                }
+                if (_async.tail == queued)
+                {
+                    _async.tail = previous;
+                }
+                queued->status = DfMp3_AsyncStatus_Cancelled;
+                queued->next = nullptr;
+                *cancelled = queued;
+                cancelled = &queued->next;
+                count++;
+            }
+            else
+            {
+                previous = queued;
+            }
+            queued = next;
+        }
+        return count;
+    }
+
+    bool isAsyncIdle() const
+    {
+        return (_async.head == nullptr && _async.cancelled == nullptr);
+    }
+#endif
+
+    // Only available with Mp3ChipAutoDetect as the T_CHIP_VARIANT.
+    // Fingerprints the module by what it answers to and binds
+    // the chip variant to match, call once after begin()/reset().
+    // Can take a few seconds on modules that don't answer.
+    DfMp3_ChipVariant probeChipVariant(uint16_t* softwareVersion = nullptr)
+    {
+        LockGuard guard(*this);
+        DfMp3_ChipVariant variant = DfMp3_ChipVariant_Original;
+        reply_t reply;
+
+        drainResponses();
+        _serial.setTimeout(c_AckTimeout);
+
+        // does it accept packets with a checksum
+        reply = probeCommand(Mp3ChipOriginal::generatePacket(Mp3_Commands_GetSoftwareVersion, 0), 
+                Mp3_Commands_GetSoftwareVersion);
+        if (reply.command == Mp3_Commands_GetSoftwareVersion)
+        {
+            // does it ack an action, setting the volume to what it is now
+            reply_t volume = probeCommand(Mp3ChipOriginal::generatePacket(Mp3_Commands_GetVolume, 0),
+                    Mp3_Commands_GetVolume);
+
+            if (volume.command == Mp3_Commands_GetVolume &&
+                probeCommand(Mp3ChipOriginal::generatePacket(Mp3_Commands_SetVolume, volume.arg, true),
+                    Mp3_Replies_Ack).command != Mp3_Replies_Ack)
+            {
+                variant = DfMp3_ChipVariant_IncongruousNoAck;
+            }
+        }
+        else
+        {
+            // or only packets without a checksum
+            reply = probeCommand(Mp3ChipMH2024K16SS::generatePacket(Mp3_Commands_GetSoftwareVersion, 0),
+                    Mp3_Commands_GetSoftwareVersion);
+            if (reply.command == Mp3_Commands_GetSoftwareVersion)
+            {
+                variant = DfMp3_ChipVariant_MH2024K16SS;
+            }
+        }
+
+        if (softwareVersion)
+        {
+            *softwareVersion = reply.arg;
+        }
+
+        T_CHIP_VARIANT::setVariant(variant);
+        return variant;
+    }
+
+#ifdef DfMiniMp3Stats
+    // counts of what the reception path decoded and dropped
+    const DfMp3_ReceptionStats& getReceptionStats() const
+    {
+        return _receptionStats;
+    }
+
+    // counts and timing of commands sent and notifications called
+    const DfMp3_TransactionStats& getTransactionStats() const
+    {
+        return _transactionStats;
+    }
+
+    // time from a track finished being read to the next play command
+    // sent, by playClipChain() or by the sketch
+    const DfMp3_ClipGapStats& getClipGapStats() const
+    {
+        return _clipGapStats;
+    }
+
+    void resetStats()
+    {
+        _receptionStats = {};
+        _transactionStats = {};
+        _clipGapStats = {};
+    }
+
+    // valid while a notification method is being called, the millis()
+    // when the notification was read from the module, so the time 
+    // it waited in the queue is millis() - getNotificationReceived()
+    uint32_t getNotificationReceived() const
+    {
+        return _notificationReceived;
+    }
+
+    // all stats as a single line of JSON, for logging and comparing runs
+    template <class T_STREAM> void printStats(T_STREAM& out) const
+    {
+        out.print("{\"packets\":");
+        out.print(_receptionStats.packets);
+        out.print(",\"bytesDiscarded\":");
+        out.print(_receptionStats.bytesDiscarded);
+        out.print(",\"resyncs\":");
+        out.print(_receptionStats.resyncs);
+        out.print(",\"timeouts\":");
+        out.print(_receptionStats.timeouts);
+        out.print(",\"errorsSize\":");
+        out.print(_receptionStats.errorsSize);
+        out.print(",\"errorsHeader\":");
+        out.print(_receptionStats.errorsHeader);
+        out.print(",\"errorsChecksum\":");
+        out.print(_receptionStats.errorsChecksum);
+        out.print(",\"transactions\":");
+        out.print(_transactionStats.transactions);
+        out.print(",\"sends\":");
+        out.print(_transactionStats.sends);
+        out.print(",\"shared\":");
+        out.print(_transactionStats.shared);
+        out.print(",\"failures\":");
+        out.print(_transactionStats.failures);
+        out.print(",\"errors\":");
+        out.print(_transactionStats.errors);
+        out.print(",\"latencyTotalUs\":");
+        out.print(_transactionStats.latencyTotal);
+        out.print(",\"latencyMaxUs\":");
+        out.print(_transactionStats.latencyMax);
+        out.print(",\"latencyHistogramMs\":");
+        printHistogram(out, _transactionStats.latencyHistogram);
+        out.print(",\"notifications\":");
+        out.print(_transactionStats.notifications);
+        out.print(",\"notificationTimeUs\":");
+        out.print(_transactionStats.notificationTime);
+        out.print(",\"dwellMaxMs\":");
+        out.print(_transactionStats.dwellMax);
+        out.print(",\"dwellHistogramMs\":");
+        printHistogram(out, _transactionStats.dwellHistogram);
+        out.print(",\"clipGaps\":");
+        out.print(_clipGapStats.gaps);
+        out.print(",\"clipGapTotalUs\":");
+        out.print(_clipGapStats.gapTotal);
+        out.print(",\"clipGapMaxUs\":");
+        out.print(_clipGapStats.gapMax);
+        out.print(",\"clipGapHistogramMs\":");
+        printHistogram(out, _clipGapStats.gapHistogram);
+        out.println("}");
+    }
+#endif
+
+#ifdef DfMiniMp3Trace
+    // DfMiniMp3Trace is defined as the number of packets retained,
+    // #define DfMiniMp3Trace 32
+    // when full the oldest packets are discarded
+    uint8_t getTraceCount() const
+    {
+        return _trace.Count();
+    }
+
+    // index zero is the oldest packet
+    bool getTraceRecord(uint8_t index, DfMp3_TraceRecord* record) const
+    {
+        return _trace.Peek(index, record);
+    }
+
+    void clearTrace()
+    {
+        _trace.Clear();
+    }
+
+    // raw binary dump, oldest first, of DfMp3_TraceRecord
+    // that can be fed to Mp3TraceReplaySerial on a host
+    template <class T_STREAM> void dumpTrace(T_STREAM& out) const
+    {
+        DfMp3_TraceRecord record;
+
+        for (uint8_t index = 0; _trace.Peek(index, &record); index++)
+        {
+            out.write(reinterpret_cast<const uint8_t*>(&record), sizeof(record));
+        }
+    }
+#endif
+
+#ifdef DfMiniMp3TrackDurations
+    // DfMiniMp3TrackDurations is defined as the number of tracks whose
+    // play time is learned, from the ack of the play command to the track
+    // reported finished, less any pause
+    // #define DfMiniMp3TrackDurations 64
+    // when full the oldest learned is replaced
+
+    // ms, zero until the track has been heard to its end once;
+    // the command and arg as the play method sends them, such as
+    // Mp3_Commands_PlayFolderTrack with (folder << 8) | track
+    uint32_t getTrackDuration(uint8_t command, uint16_t arg) const
+    {
+        uint8_t index = findTrackDuration(command, arg);
+
+        if (index >= _trackDurations.count)
+        {
+            return 0;
+        }
+        return _trackDurations.entries[index].duration * 100UL;
+    }
+
+    // for durations known by other means, such as a media manifest
+    void setTrackDuration(uint8_t command, uint16_t arg, uint32_t duration)
+    {
+        uint8_t index = findTrackDuration(command, arg);
+        uint32_t tenths = (duration + 50) / 100;
+
+        if (index >= _trackDurations.count)
+        {
+            if (_trackDurations.count < DfMiniMp3TrackDurations)
+            {
+                index = _trackDurations.count++;
+            }
+            else
+            {
+                index = _trackDurations.next;
+                _trackDurations.next = (index + 1) % DfMiniMp3TrackDurations;
+            }
+            _trackDurations.entries[index].command = command;
+            _trackDurations.entries[index].arg = arg;
+        }
+        _trackDurations.entries[index].duration = (tenths < 0xffff) ? tenths : 0xffff;
+    }
+
+    // ms the playing track has left, so the next thing can be readied
+    // ahead of its end; false when what is playing or its duration is 
+    // not known, as for tracks reached by next, loop or random
+    bool getTrackRemaining(uint32_t* remaining) const
+    {
+        uint32_t duration = 0;
+
+        if (_isTrackTimed && _trackKey.command != Mp3_Commands_None)
+        {
+            duration = getTrackDuration(_trackKey.command, _trackKey.arg);
+        }
+        if (duration == 0)
+        {
+            return false;
+        }
+
+        uint32_t elapsed = (_isTrackPaused ? _trackPaused : millis()) - _trackStarted;
+
+        *remaining = (elapsed < duration) ? (duration - elapsed) : 0;
+        return true;
+    }
+
+    uint8_t getTrackDurationCount() const
+    {
+        return _trackDurations.count;
+    }
+
+    void clearTrackDurations()
+    {
+        _trackDurations.count = 0;
+        _trackDurations.next = 0;
+    }
+
+    bool saveTrackDurations(DfMp3_SnapshotWrite write, void* context = nullptr)
+    {
+        _trackDurations.version = DfMp3_TrackDurationsVersion;
+        _trackDurations.capacity = DfMiniMp3TrackDurations;
+        _trackDurations.crc = trackDurationsCrc(_trackDurations);
+        return write(reinterpret_cast<const uint8_t*>(&_trackDurations), 
+                sizeof(_trackDurations), 
+                context);
+    }
+
+    // what was learned since is replaced, unless it fails
+    DfMp3_SnapshotResult loadTrackDurations(DfMp3_SnapshotRead read, void* context = nullptr)
+    {
+        trackDurations_t stored;
+
+        if (!read(reinterpret_cast<uint8_t*>(&stored), sizeof(stored), context))
+        {
+            return DfMp3_SnapshotResult_NotFound;
+        }
+
+        if (stored.version != DfMp3_TrackDurationsVersion ||
+            stored.capacity != DfMiniMp3TrackDurations ||
+            stored.count > DfMiniMp3TrackDurations ||
+            stored.next >= DfMiniMp3TrackDurations ||
+            stored.crc != trackDurationsCrc(stored))
+        {
+            return DfMp3_SnapshotResult_Invalid;
+        }
+
+        _trackDurations = stored;
+        return DfMp3_SnapshotResult_Restored;
+    }
+#endif
+
+private:
+    typedef typename T_CHIP_VARIANT::SendPacket SendPacket;
+    typedef Mp3LockGuard<T_LOCK_POLICY> LockGuard;
+
+    struct reply_t
+    {
+        uint8_t command = 0;
+        uint16_t arg = 0;
+#ifdef DfMiniMp3Stats
+        uint32_t received = 0; // millis() when decoded
+#endif
+
+        bool isUndefined()
+        {
+            return (command == Mp3_Commands_None);
+        }
+
+    };
+
+    // the outstanding request, so replies can be told from notifications
+    struct transaction_t
+    {
+        uint8_t command; // Mp3_Commands_None when there is none
+        uint32_t sent; // millis() of the last send
+    };
+
+    // the last command that started playing something
+    struct play_t
+    {
+        uint8_t command; // Mp3_Commands_None when there was none
+        uint16_t arg;
+    };
+
+#ifdef DfMiniMp3Async
+    // the queueAsync() requests by lane, the head is the one on the wire
+    struct async_t
+    {
+        DfMp3_AsyncRequest* head;
+        DfMp3_AsyncRequest* tail;
+        DfMp3_AsyncRequest* cancelled; // for runAsync() to complete
+        bool isBlocked; // a blocking call waits for the head
+        SendPacket packet; // wire ready, for retries
+        uint8_t packetSize;
+        uint8_t expected; // the reply command that completes the head
+        uint8_t retries; // sends left
+        play_t lastPlay; // as it was before the head was sent
+        bool wasPlaybackExpected;
+    };
+#endif
+
+#ifdef DfMiniMp3QueryCache
+    // a recent query reply, given to callers asking the same
+    struct shared_t
+    {
+        uint8_t command; // Mp3_Commands_None when unused
+        bool isCacheable; // only our own commands change it
+        uint16_t arg;
+        uint16_t reply;
+        uint16_t completion; // _queryCompletions as it completed
+        uint32_t completed; // millis()
+    };
+#endif
+
+#ifdef DfMiniMp3MediaDebounce
+    // a slot for each DfMp3_PlaySources bit, then one for online
+    static const uint8_t c_MediaOnline = 4;
+
+    struct media_t
+    {
+        uint16_t settleTime = DfMiniMp3MediaDebounce; // ms
+        uint8_t reported; // DfMp3_PlaySources as last notified
+        uint8_t settling; // slot bits with reports held
+        uint8_t held[c_MediaOnline + 1]; // reports held per slot
+        uint32_t changed[c_MediaOnline + 1]; // millis() of the last
+        DfMp3_MediaStats stats;
+    };
+#endif
+
+#ifdef DfMiniMp3PowerManagement
+    struct power_t
+    {
+        bool isSleeping;
+        bool isDacDisabled;
+        bool isWaking;
+        uint32_t slept; // millis() of the sleep command
+        uint32_t lastActivity; // millis()
+        DfMp3_PowerStats stats;
+    };
+#endif
+
+#ifdef DfMiniMp3TrackDurations
+    // saved and loaded as is, the crc covers all that follows it
+    struct trackDurations_t
+    {
+        uint16_t crc;
+        uint8_t version; // DfMp3_TrackDurationsVersion
+        uint8_t capacity; // DfMiniMp3TrackDurations
+        uint8_t count;
+        uint8_t next; // replaced next once full
+        DfMp3_TrackDuration entries[DfMiniMp3TrackDurations];
+    };
+#endif
+
+#ifdef DfMiniMp3PendingCommands
+    // an action deferred while a notification was being called
+    struct pending_t
+    {
+        uint8_t command;
+        uint16_t arg;
+        bool noAck;
+    };
+#endif
+
+    const uint32_t c_AckTimeout = C_ACK_TIMEOUT;
+    const uint32_t c_NoAckTimeout = 50; // 30ms observerd, added a little overhead
+    // some modules report a track finished twice, no clip is this short
+    static const uint32_t c_ClipChainRepeatWindow = 100;
+    // bytes one readPacket() may drop, syncing and resyncing together,
+    // before it returns to let the caller do something else
+    static const uint16_t c_MaxSyncDiscard = 3 * sizeof(typename T_CHIP_VARIANT::ReceptionPacket);
+
+    T_SERIAL_METHOD& _serial;
+#ifndef DfMiniMp3NoRetries
+    uint8_t _comRetries;
+#endif
+    volatile bool _isOnline;
+#ifndef DfMiniMp3NoStateTracking
+    uint8_t _playSources; // DfMp3_PlaySources as last reported
+    transaction_t _transaction;
+    play_t _lastPlay;
+    bool _isPlaybackExpected;
+    uint32_t _playbackCommanded;
+#endif
+#ifdef DfMiniMp3PendingCommands
+    uint8_t _notificationDepth; // nested notification calls in progress
+    ringSimple_t<pending_t, DfMiniMp3PendingCommands> _pendingCommands;
+#endif
+#ifdef DfMiniMp3ClipChain
+    ringSimple_t<uint16_t, DfMiniMp3ClipChain> _clipChain;
+    uint32_t _clipChainSent; // millis() the last clip was started
+    bool _isClipDue; // a track finished, the next clip waits for loop()
+#endif
+#ifdef DfMiniMp3Async
+    async_t _async;
+#endif
+#ifdef DfMiniMp3QueryCache
+    shared_t _sharedQueries[DfMiniMp3QueryCache];
+#ifdef Mp3_QueryCompletionsAtomic
+    std::atomic<uint16_t> _queryCompletions;
+#else
+    uint16_t _queryCompletions;
+#endif
+#endif
+#ifdef DfMiniMp3PowerManagement
+    power_t _power;
+#endif
+#ifdef DfMiniMp3MediaDebounce
+    media_t _media;
+#endif
+#ifdef DfMiniMp3TrackDurations
+    trackDurations_t _trackDurations;
+    play_t _trackKey; // what is playing, Mp3_Commands_None when not known
+    uint32_t _trackStarted; // millis(), when _isTrackTimed
+    uint32_t _trackPaused; // millis() of the pause, when _isTrackPaused
+    bool _isTrackTimed;
+    bool _isTrackPaused;
+#endif
+#ifdef DfMiniMp3Debug
+    int8_t _inTransaction;
+    Mp3DebugLog _log;
+#endif
+#if defined(DfMiniMp3NoNotifications)
+#elif defined(DfMiniMp3NotificationQueue)
+    ringSimple_t<reply_t, DfMiniMp3NotificationQueue> _queueNotifications;
+#else
+    queueSimple_t<reply_t> _queueNotifications;
+#endif
+#ifdef DfMiniMp3Stats
+    DfMp3_ReceptionStats _receptionStats;
+    DfMp3_TransactionStats _transactionStats;
+    uint32_t _notificationReceived;
+    DfMp3_ClipGapStats _clipGapStats;
+    uint32_t _trackFinished; // micros() a track finished was read
+    bool _isTrackFinished; // and no play command was sent since
+#endif
+#ifdef DfMiniMp3Trace
+    ringSimple_t<DfMp3_TraceRecord, DfMiniMp3Trace> _trace;
+
+    void tracePacket(DfMp3_TraceDirection direction, const uint8_t* data, size_t dataSize)
+    {
+        DfMp3_TraceRecord record;
+
+        record.timestamp = micros();
+        record.direction = direction;
+        record.length = (dataSize < sizeof(record.data)) ? dataSize : sizeof(record.data);
+        memcpy(record.data, data, record.length);
+
+        _trace.EnqueueOverwrite(record);
+    }
+#endif
+
+#ifdef DfMiniMp3NoNotifications
+    void appendNotification([[maybe_unused]] reply_t reply)
+    {
+    }
+
+    bool abateNotification()
+    {
+        return false;
+    }
+#else
+    void appendNotification(reply_t reply)
+    {
+        // store the notification for later calling so
+        // current comms transactions can be finished
+        // without interruption, a fixed queue drops it when full
+        _queueNotifications.Enqueue(reply);
+    }
+
+    bool abateNotification()
+    {
+        // remove the first notification and call it
+        reply_t reply;
+        bool wasAbated = false;
+        if (_queueNotifications.Dequeue(&reply))
+        {
+#ifdef DfMiniMp3Stats
+            uint32_t started = micros();
+            uint32_t dwell = millis() - reply.received;
+
+            _transactionStats.dwellHistogram[DfMp3_HistogramBucket(dwell)]++;
+            if (dwell > _transactionStats.dwellMax)
+            {
+                _transactionStats.dwellMax = dwell;
+            }
+            _notificationReceived = reply.received;
+#endif
+            DfMp3_SpanBegin(DfMp3_Span_Notification, reply.command);
+            enterNotification();
+            callNotification(reply);
+            leaveNotification();
+            DfMp3_SpanEnd(DfMp3_Span_Notification, reply.command, reply.arg);
+            wasAbated = true;
+#ifdef DfMiniMp3Stats
+            _transactionStats.notifications++;
+            _transactionStats.notificationTime += micros() - started;
+#endif
+        }
+        return wasAbated;
+    }
+
+    void callNotification(reply_t reply)
+    {
+        switch (reply.command)
+        {
+        case Mp3_Replies_TrackFinished_Usb: // usb
+            T_NOTIFICATION_METHOD::OnPlayFinished(*this, DfMp3_PlaySources_Usb, reply.arg);
+            break;
+
+        case Mp3_Replies_TrackFinished_Sd: // micro sd
+            T_NOTIFICATION_METHOD::OnPlayFinished(*this, DfMp3_PlaySources_Sd, reply.arg);
+            break;
+
+        case Mp3_Replies_TrackFinished_Flash: // flash
+            T_NOTIFICATION_METHOD::OnPlayFinished(*this, DfMp3_PlaySources_Flash, reply.arg);
+            break;
+
+        case Mp3_Replies_PlaySource_Online:
+            T_NOTIFICATION_METHOD::OnPlaySourceOnline(*this, static_cast<DfMp3_PlaySources>(reply.arg));
+            break;
+
+        case Mp3_Replies_PlaySource_Inserted:
+            T_NOTIFICATION_METHOD::OnPlaySourceInserted(*this, static_cast<DfMp3_PlaySources>(reply.arg));
+            break;
+
+        case Mp3_Replies_PlaySource_Removed:
+            T_NOTIFICATION_METHOD::OnPlaySourceRemoved(*this, static_cast<DfMp3_PlaySources>(reply.arg));
+            break;
+
+        case Mp3_Replies_Error: // error
+            T_NOTIFICATION_METHOD::OnError(*this, reply.arg);
+            break;
+
+        default:
+#if defined(DfMiniMp3Debug) && (DfMiniMp3DebugLevel >= DfMp3_DebugLevel_Notify)
+            _log.logReply(Mp3_LogEvent_InvalidNotification, reply.command, reply.arg);
+#endif
+            break;
+        }
+    }
+#endif
+
+    void pumpNotifications()
+    {
+#ifdef DfMiniMp3MediaDebounce
+        settleMedia();
+#endif
+        // call all outstanding notifications
+        while (abateNotification());
+
+#ifdef DfMiniMp3Async
+        if (isAsyncPending())
+        {
+            // what arrived may be the reply it waits on
+            pumpAsync();
+            return;
+        }
+#endif
+
+        // check for any new notifications in comms
+        uint8_t maxDrains = 6;
+
+        while (maxDrains &&
+            _serial.available() >= static_cast<int>(sizeof(typename T_CHIP_VARIANT::ReceptionPacket)))
+        {
+            listenForReply(Mp3_Commands_None);
+            maxDrains--;
+        }
+    }
+
+    void drainResponses()
+    {
+#ifdef DfMiniMp3Async
+        // the module takes one command at a time, 
+        // so the async one on the wire is seen through first
+        _async.isBlocked = true;
+        while (isAsyncPending())
+        {
+            pumpAsync();
+            // its reply is ms away, others may run meanwhile
+            yield();
+        }
+        _async.isBlocked = false;
+#endif
+        pumpNotifications();
+    }
+
+#ifdef DfMiniMp3Async
+    bool isAsyncPending() const
+    {
+        return (_async.head && _async.head->status == DfMp3_AsyncStatus_Pending);
+    }
+
+    static DfMp3_AsyncLane laneForCommand(uint8_t command, uint8_t flags)
+    {
+        switch (command)
+        {
+        case Mp3_Commands_Stop:
+        case Mp3_Commands_Pause:
+        case Mp3_Commands_PlayAdvertTrack:
+        case Mp3_Commands_StopAdvert:
+            return DfMp3_AsyncLane_Realtime;
+
+        default:
+            return (flags & Mp3_CommandFlags_Query) ? 
+                DfMp3_AsyncLane_Background : 
+                DfMp3_AsyncLane_Interactive;
+        }
+    }
+
+    // after the requests of its lane and those above, or first in its
+    // lane, the pending head keeps its place whatever its lane
+    void insertAsync(DfMp3_AsyncRequest* request, bool isFirstInLane = false)
+    {
+        DfMp3_AsyncRequest* previous = nullptr;
+        DfMp3_AsyncRequest* queued = _async.head;
+
+        while (queued && 
+            (queued->lane < request->lane || 
+                (queued->lane == request->lane && !isFirstInLane) || 
+                queued->status != DfMp3_AsyncStatus_Queued))
+        {
+            previous = queued;
+            queued = queued->next;
+        }
+
+        request->next = queued;
+        if (previous)
+        {
+            previous->next = request;
+        }
+        else
+        {
+            _async.head = request;
+        }
+        if (queued == nullptr)
+        {
+            _async.tail = request;
+        }
+    }
+
+    // a background query on the wire is not retried while anything
+    // more urgent waits, it goes back to the front of its lane instead,
+    // so that waits one try rather than all; other lanes are seen through as 
+    // they have effects the waiting one may depend on
+    bool isAsyncPreempted(const DfMp3_AsyncRequest* request) const
+    {
+        return (request->lane == DfMp3_AsyncLane_Background &&
+            (_async.isBlocked || 
+                (request->next && request->next->lane < DfMp3_AsyncLane_Background)));
+    }
+
+    // from loop(), completes the finished requests and sends the next
+    void runAsync()
+    {
+        DfMp3_AsyncRequest* request;
+
+        while ((request = _async.cancelled) != nullptr)
+        {
+            _async.cancelled = request->next;
+            request->next = nullptr;
+            if (request->complete)
+            {
+                request->complete(request);
+            }
+        }
+
+        while ((request = _async.head) != nullptr &&
+            request->status != DfMp3_AsyncStatus_Pending)
+        {
+            if (request->status == DfMp3_AsyncStatus_Queued)
+            {
+                sendAsync(request);
+                continue;
+            }
+
+            // unlinked first, complete may queue it again or free it
+            _async.head = request->next;
+            if (_async.head == nullptr)
+            {
+                _async.tail = nullptr;
+            }
+            request->next = nullptr;
+            if (request->complete)
+            {
+                request->complete(request);
+            }
+        }
+    }
+
+    void sendAsync(DfMp3_AsyncRequest* request)
+    {
+        bool isQuery = (request->flags & Mp3_CommandFlags_Query);
+
+#ifdef DfMiniMp3PowerManagement
+        // blocks for the wake, as asleep is the exception
+        wakeFor(request->command);
+#endif
+
+        if (request->flags & Mp3_CommandFlags_NoAck)
+        {
+            SendPacket packet = T_CHIP_VARIANT::generatePacket(request->command, request->arg);
+
+            sendPacket(packet, T_CHIP_VARIANT::toWire(&packet));
+            request->status = DfMp3_AsyncStatus_Done;
+            return;
+        }
+
+        _async.packet = T_CHIP_VARIANT::generatePacket(request->command, request->arg, !isQuery);
+        _async.packetSize = T_CHIP_VARIANT::toWire(&_async.packet);
+        _async.expected = isQuery ? request->command : static_cast<uint8_t>(Mp3_Replies_Ack);
+#ifdef DfMiniMp3NoRetries
+        _async.retries = 1;
+#else
+        _async.retries = _comRetries;
+#endif
+        _transaction.command = request->command;
+        _async.lastPlay = _lastPlay;
+        _async.wasPlaybackExpected = _isPlaybackExpected;
+        request->status = DfMp3_AsyncStatus_Pending;
+
+        DfMp3_SpanBegin(DfMp3_Span_Transaction, request->command);
+        sendPacket(_async.packet, _async.packetSize);
+    }
+
+    // only what has arrived is read, nothing is waited for
+    void pumpAsync()
+    {
+        DfMp3_AsyncRequest* request = _async.head;
+        bool supportsAck = T_CHIP_VARIANT::commandSupportsAck(request->command);
+        reply_t reply;
+
+        while (request->status == DfMp3_AsyncStatus_Pending &&
+            _serial.available() >= static_cast<int>(sizeof(typename T_CHIP_VARIANT::ReceptionPacket)))
+        {
+            if (readPacket(&reply) && takeReply(reply, request->command))
+            {
+                if (reply.command == _async.expected)
+                {
+                    finishAsync(request, DfMp3_AsyncStatus_Done, reply.arg);
+                }
+                else
+                {
+                    // without ack support only an error is retried
+                    retryAsync(request, reply, supportsAck || reply.command == Mp3_Replies_Error);
+                }
+            }
+        }
+
+        if (request->status == DfMp3_AsyncStatus_Pending &&
+            (millis() - _transaction.sent) >= (supportsAck ? c_AckTimeout : c_NoAckTimeout))
+        {
+            if (!supportsAck && _async.expected == Mp3_Replies_Ack)
+            {
+                // no error in time is all there is to go on
+                finishAsync(request, DfMp3_AsyncStatus_Done, 0);
+            }
+            else
+            {
+                reply = {};
+                reply.arg = DfMp3_Error_RxTimeout;
+                retryAsync(request, reply, supportsAck);
+            }
+        }
+    }
+
+    void retryAsync(DfMp3_AsyncRequest* request, const reply_t& reply, bool isRetryable)
+    {
+        if (isRetryable && isAsyncPreempted(request))
+        {
+            _async.head = request->next;
+            if (_async.head == nullptr)
+            {
+                _async.tail = nullptr;
+            }
+            request->status = DfMp3_AsyncStatus_Queued;
+            _transaction.command = Mp3_Commands_None;
+            DfMp3_SpanEnd(DfMp3_Span_Transaction, request->command, DfMp3_AsyncStatus_Queued);
+            insertAsync(request, true);
+            return;
+        }
+
+        if (isRetryable && _async.retries > 1)
+        {
+            _async.retries--;
+            DfMp3_SpanInstant(DfMp3_Span_Retry, request->command);
+            sendPacket(_async.packet, _async.packetSize);
+            return;
+        }
+
+        if (reply.command == Mp3_Replies_Error)
+        {
+            // OnError is called as for any other notification
+            appendNotification(reply);
+#ifdef DfMiniMp3Stats
+            _transactionStats.errors++;
+#endif
+        }
+#ifdef DfMiniMp3Stats
+        else
+        {
+            _transactionStats.failures++;
+        }
+#endif
+        notePlaybackFailed(request->command, _async.lastPlay, _async.wasPlaybackExpected);
+        finishAsync(request, DfMp3_AsyncStatus_Failed, reply.arg);
+    }
+
+    void finishAsync(DfMp3_AsyncRequest* request, DfMp3_AsyncStatus status, uint16_t result)
+    {
+        request->status = status;
+        request->result = result;
+        _transaction.command = Mp3_Commands_None;
+#ifdef DfMiniMp3Stats
+        _transactionStats.transactions++;
+#endif
+        DfMp3_SpanEnd(DfMp3_Span_Transaction, request->command, status);
+    }
+#endif
+
+    // called as a track finished is read, before it is queued; this 
+    // may be within another transaction, so the next clip is only 
+    // marked due and loop() sends it once that one is done
+    void stageNextClip()
+    {
+#ifdef DfMiniMp3Stats
+        _trackFinished = micros();
+        _isTrackFinished = true;
+#endif
+#ifdef DfMiniMp3ClipChain
+        if ((millis() - _clipChainSent) >= c_ClipChainRepeatWindow &&
+            _clipChain.Count())
+        {
+            _isClipDue = true;
+        }
+#endif
+    }
+
+#ifdef DfMiniMp3ClipChain
+    // called from loop() ahead of the notifications, so the next clip
+    // starts without waiting on their round trips
+    void sendNextClip()
+    {
+        uint16_t clip;
+
+#ifdef DfMiniMp3Async
+        if (isAsyncPending())
+        {
+            // the reply being waited on comes first, a later loop() sends it
+            return;
+        }
+#endif
+        if (_isClipDue && _clipChain.Dequeue(&clip))
+        {
+            _isClipDue = false;
+            _clipChainSent = millis();
+            playMp3FolderTrack(clip);
+        }
+    }
+#else
+    void sendNextClip()
+    {
+    }
+#endif
+
+    // actions from within a notification are queued rather than nesting
+    // a transaction inside whatever is calling the notification, 
+    // queries still nest as their reply is needed right away
+#ifdef DfMiniMp3PendingCommands
+    void enterNotification()
+    {
+        _notificationDepth++;
+    }
+
+    void leaveNotification()
+    {
+        _notificationDepth--;
+    }
+
+    bool deferCommand(uint8_t command, uint16_t arg, bool noAck = false)
+    {
+        if (_notificationDepth == 0)
+        {
+            return false;
+        }
+
+        pending_t pending = { command, arg, noAck };
+        return _pendingCommands.Enqueue(pending);
+    }
+
+    void runPendingCommands()
+    {
+        LockGuard guard(*this);
+        pending_t pending;
+
+        while (_pendingCommands.Dequeue(&pending))
+        {
+            if (pending.noAck)
+            {
+                SendPacket packet = T_CHIP_VARIANT::generatePacket(pending.command, pending.arg);
+
+#ifdef DfMiniMp3PowerManagement
+                wakeFor(pending.command);
+#endif
+                drainResponses();
+                sendPacket(packet, T_CHIP_VARIANT::toWire(&packet));
+            }
+            else
+            {
+                retryCommand(T_CHIP_VARIANT::generatePacket(pending.command, pending.arg, true), 
+                        Mp3_Replies_Ack);
+            }
+        }
+    }
+#else
+    void enterNotification()
+    {
+    }
+
+    void leaveNotification()
+    {
+    }
+
+    bool deferCommand([[maybe_unused]] uint8_t command, 
+        [[maybe_unused]] uint16_t arg, 
+        [[maybe_unused]] bool noAck = false)
+    {
+        return false;
+    }
+
+    void runPendingCommands()
+    {
+    }
+#endif
+
+    template <class T_PACKET> void sendPacket(const T_PACKET& packet, uint8_t size = sizeof(T_PACKET))
+    {
+#if defined(DfMiniMp3Debug) && (DfMiniMp3DebugLevel >= DfMp3_DebugLevel_Packet)
+        _log.logPacket(Mp3_LogEvent_PacketOut, reinterpret_cast<const uint8_t*>(&packet), size);
+#endif
+
+        _serial.write(reinterpret_cast<const uint8_t*>(&packet), size);
+#ifndef DfMiniMp3NoStateTracking
+        _transaction.sent = millis();
+        notePlayback(packet.command, (packet.hiByteArgument << 8) | packet.lowByteArgument);
+#endif
+#ifdef DfMiniMp3TrackDurations
+        noteTrack(packet.command, (packet.hiByteArgument << 8) | packet.lowByteArgument);
+#endif
+#ifdef DfMiniMp3PowerManagement
+        notePower(packet.command, (packet.hiByteArgument << 8) | packet.lowByteArgument);
+#endif
+#ifdef DfMiniMp3QueryCache
+        if (packet.command < Mp3_Commands_Requests)
+        {
+            // any action may change what queries would reply
+            forgetSharedQueries(true);
+        }
+#endif
+
+#ifdef DfMiniMp3Stats
+        _transactionStats.sends++;
+        recordClipGap(packet.command);
+#endif
+
+#ifdef DfMiniMp3Trace
+        tracePacket(DfMp3_TraceDirection_Out, reinterpret_cast<const uint8_t*>(&packet), size);
+#endif
+    }
+
+#ifndef DfMiniMp3NoStateTracking
+    void notePlayback(uint8_t command, uint16_t arg)
+    {
+        switch (command)
+        {
+        case Mp3_Commands_PlayGlobalTrack:
+        case Mp3_Commands_LoopGlobalTrack:
+        case Mp3_Commands_PlayFolderTrack:
+        case Mp3_Commands_PlayMp3FolderTrack:
+        case Mp3_Commands_PlayFolderTrack16:
+        case Mp3_Commands_LoopInFolder:
+        case Mp3_Commands_PlayRandmomGlobalTrack:
+            _lastPlay.command = command;
+            _lastPlay.arg = arg;
+            // fall through
+        case Mp3_Commands_PlayNextTrack:
+        case Mp3_Commands_PlayPrevTrack:
+        case Mp3_Commands_Start:
+            _isPlaybackExpected = true;
+            _playbackCommanded = millis();
+            break;
+
+        case Mp3_Commands_Pause:
+        case Mp3_Commands_Stop:
+        case Mp3_Commands_Sleep:
+        case Mp3_Commands_Reset:
+            _isPlaybackExpected = false;
+            break;
+        }
+    }
+
+    // a play the module rejected or never acked did not start, so
+    // what was expected before it still is and it is not replayed
+    void notePlaybackFailed(uint8_t command, const play_t& lastPlay, bool wasPlaybackExpected)
+    {
+        switch (command)
+        {
+        case Mp3_Commands_PlayGlobalTrack:
+        case Mp3_Commands_LoopGlobalTrack:
+        case Mp3_Commands_PlayFolderTrack:
+        case Mp3_Commands_PlayMp3FolderTrack:
+        case Mp3_Commands_PlayFolderTrack16:
+        case Mp3_Commands_LoopInFolder:
+        case Mp3_Commands_PlayRandmomGlobalTrack:
+        case Mp3_Commands_PlayNextTrack:
+        case Mp3_Commands_PlayPrevTrack:
+        case Mp3_Commands_Start:
+            _lastPlay = lastPlay;
+            _isPlaybackExpected = wasPlaybackExpected;
+            break;
+        }
+    }
+#endif
+
+    // the media changed or the module restarted
+    void noteMedia(const reply_t& reply)
+    {
+#ifdef DfMiniMp3QueryCache
+        forgetSharedQueries(true);
+#endif
+#ifdef DfMiniMp3MediaDebounce
+        holdMedia(reply);
+#else
+        appendNotification(reply);
+#endif
+    }
+
+#ifdef DfMiniMp3MediaDebounce
+    void holdMedia(const reply_t& reply)
+    {
+        uint32_t now = millis();
+        uint8_t slots = (reply.command == Mp3_Replies_PlaySource_Online) ? 
+                (1 << c_MediaOnline) : 
+                (reply.arg & ((1 << c_MediaOnline) - 1));
+
+        _media.stats.events++;
+        if (slots == 0)
+        {
+            // a source we don't know, pass it on as is
+            appendNotification(reply);
+            return;
+        }
+        for (uint8_t slot = 0; slot <= c_MediaOnline; slot++)
+        {
+            if (slots & (1 << slot))
+            {
+                _media.held[slot]++;
+                _media.changed[slot] = now;
+            }
+        }
+        _media.settling |= slots;
+    }
+
+    // notifies the sources that settled, the reports held for them
+    // are collapsed into their change from what was last notified;
+    // an online report waits for all sources and stands for them
+    void settleMedia()
+    {
+        uint32_t now = millis();
+        uint32_t suppressed = 0;
+
+        if (_media.settling == 0)
+        {
+            return;
+        }
+
+        for (uint8_t slot = 0; slot <= c_MediaOnline; slot++)
+        {
+            uint8_t bit = 1 << slot;
+
+            if ((_media.settling & bit) &&
+                (now - _media.changed[slot]) >= _media.settleTime &&
+                (slot != c_MediaOnline || _media.settling == bit))
+            {
+                suppressed += _media.held[slot];
+                _media.held[slot] = 0;
+                _media.settling &= ~bit;
+
+                if (slot == c_MediaOnline)
+                {
+                    notifyMedia(Mp3_Replies_PlaySource_Online, _playSources);
+                    _media.reported = _playSources;
+                    suppressed--;
+                }
+                else if ((_media.settling & (1 << c_MediaOnline)) == 0 &&
+                    ((_media.reported ^ _playSources) & bit))
+                {
+                    notifyMedia((_playSources & bit) ? 
+                            Mp3_Replies_PlaySource_Inserted : 
+                            Mp3_Replies_PlaySource_Removed, 
+                        bit);
+                    _media.reported ^= bit;
+                    suppressed--;
+                }
+            }
+        }
+        _media.stats.suppressed += suppressed;
+    }
+
+    void notifyMedia(uint8_t command, uint16_t arg)
+    {
+        reply_t reply;
+
+        reply.command = command;
+        reply.arg = arg;
+#ifdef DfMiniMp3Stats
+        reply.received = millis();
+#endif
+        appendNotification(reply);
+    }
+#endif
+
+    void noteTrackFinished([[maybe_unused]] uint16_t track)
+    {
+#ifdef DfMiniMp3TrackDurations
+        learnTrack(track);
+#endif
+#ifdef DfMiniMp3QueryCache
+        // the status and current track have moved on
+        forgetSharedQueries(false);
+#endif
+
+#ifndef DfMiniMp3NoStateTracking
+        // these keep on playing the next track
+        switch (_lastPlay.command)
+        {
+        case Mp3_Commands_LoopGlobalTrack:
+        case Mp3_Commands_LoopInFolder:
+        case Mp3_Commands_PlayRandmomGlobalTrack:
+            break;
+
+        default:
+            _isPlaybackExpected = false;
+            break;
+        }
+#endif
+    }
+
+#ifdef DfMiniMp3PowerManagement
+    void notePower(uint8_t command, uint16_t arg)
+    {
+        uint32_t now = millis();
+
+        switch (command)
+        {
+        case Mp3_Commands_Sleep:
+            if (!_power.isSleeping)
+            {
+                _power.isSleeping = true;
+                _power.slept = now;
+                _power.stats.sleeps++;
+            }
+            break;
+
+        case Mp3_Commands_Reset:
+            _power.isDacDisabled = false;
+            // fall through
+        case Mp3_Commands_Awake:
+            if (_power.isSleeping)
+            {
+                _power.isSleeping = false;
+                _power.stats.sleepTime += now - _power.slept;
+            }
+            break;
+
+        case Mp3_Commands_SetDacInactive:
+            _power.isDacDisabled = (arg != 0);
+            break;
+
+        default:
+            _power.lastActivity = now;
+            break;
+        }
+    }
+
+    // wakes the module before sending it command
+    void wakeFor(uint8_t command)
+    {
+        if ((!_power.isSleeping && !_power.isDacDisabled) || _power.isWaking)
+        {
+            return;
+        }
+
+        switch (command)
+        {
+        case Mp3_Commands_Sleep:
+        case Mp3_Commands_Awake:
+        case Mp3_Commands_Reset:
+        case Mp3_Commands_SetDacInactive:
+            return;
+        }
+
+        uint32_t started = micros();
+
+        // sent directly as a notification would defer them
+        _power.isWaking = true;
+        if (_power.isSleeping)
+        {
+            retryCommand(T_CHIP_VARIANT::generatePacket(Mp3_Commands_Awake, 0, true), Mp3_Replies_Ack);
+        }
+        if (_power.isDacDisabled)
+        {
+            retryCommand(T_CHIP_VARIANT::generatePacket(Mp3_Commands_SetDacInactive, 0, true), Mp3_Replies_Ack);
+        }
+        _power.isWaking = false;
+
+        uint32_t latency = micros() - started;
+
+        _power.stats.wakes++;
+        _power.stats.wakeLatencyTotal += latency;
+        if (latency > _power.stats.wakeLatencyMax)
+        {
+            _power.stats.wakeLatencyMax = latency;
+        }
+    }
+#endif
+
+#ifdef DfMiniMp3TrackDurations
+    static bool isTrackStart(uint8_t command)
+    {
+        switch (command)
+        {
+        case Mp3_Commands_PlayGlobalTrack:
+        case Mp3_Commands_LoopGlobalTrack:
+        case Mp3_Commands_PlayFolderTrack:
+        case Mp3_Commands_PlayMp3FolderTrack:
+        case Mp3_Commands_PlayFolderTrack16:
+        case Mp3_Commands_LoopInFolder:
+        case Mp3_Commands_PlayRandmomGlobalTrack:
+        case Mp3_Commands_PlayNextTrack:
+        case Mp3_Commands_PlayPrevTrack:
+            return true;
+        }
+        return false;
+    }
+
+    void noteTrack(uint8_t command, uint16_t arg)
+    {
+        uint32_t now = millis();
+
+        if (isTrackStart(command))
+        {
+            switch (command)
+            {
+            case Mp3_Commands_PlayGlobalTrack:
+            case Mp3_Commands_PlayFolderTrack:
+            case Mp3_Commands_PlayMp3FolderTrack:
+            case Mp3_Commands_PlayFolderTrack16:
+                _trackKey = { command, arg };
+                break;
+
+            case Mp3_Commands_LoopGlobalTrack:
+                _trackKey = { Mp3_Commands_PlayGlobalTrack, arg };
+                break;
+
+            default:
+                // only known once it is reported finished
+                _trackKey.command = Mp3_Commands_None;
+                break;
+            }
+            _trackStarted = now;
+            _isTrackTimed = true;
+            _isTrackPaused = false;
+            return;
+        }
+
+        switch (command)
+        {
+        case Mp3_Commands_Pause:
+            if (_isTrackTimed && !_isTrackPaused)
+            {
+                _trackPaused = now;
+                _isTrackPaused = true;
+            }
+            break;
+
+        case Mp3_Commands_Start:
+            if (_isTrackPaused)
+            {
+                _trackStarted += now - _trackPaused;
+                _isTrackPaused = false;
+            }
+            break;
+
+        case Mp3_Commands_Stop:
+        case Mp3_Commands_Sleep:
+        case Mp3_Commands_Reset:
+            _isTrackTimed = false;
+            _isTrackPaused = false;
+            break;
+        }
+    }
+
+    void learnTrack(uint16_t track)
+    {
+        uint32_t now = millis();
+
+        if (!_isTrackTimed || _isTrackPaused ||
+            (now - _trackStarted) < c_ClipChainRepeatWindow)
+        {
+            // not timed, or a repeated report
+            return;
+        }
+
+        if (_trackKey.command == Mp3_Commands_None)
+        {
+            setTrackDuration(Mp3_Commands_PlayGlobalTrack, track, now - _trackStarted);
+        }
+        else
+        {
+            setTrackDuration(_trackKey.command, _trackKey.arg, now - _trackStarted);
+        }
+
+        // these go on to the next track
+        switch (_lastPlay.command)
+        {
+        case Mp3_Commands_LoopGlobalTrack:
+        case Mp3_Commands_LoopInFolder:
+        case Mp3_Commands_PlayRandmomGlobalTrack:
+            _trackStarted = now;
+            break;
+
+        default:
+            _isTrackTimed = false;
+            break;
+        }
+    }
+
+    uint8_t findTrackDuration(uint8_t command, uint16_t arg) const
+    {
+        uint8_t index = 0;
+
+        while (index < _trackDurations.count &&
+            (_trackDurations.entries[index].command != command || 
+            _trackDurations.entries[index].arg != arg))
+        {
+            index++;
+        }
+        return index;
+    }
+
+    static uint16_t trackDurationsCrc(const trackDurations_t& durations)
+    {
+        return DfMp3_Crc16(&durations.version, 
+                sizeof(trackDurations_t) - offsetof(trackDurations_t, version));
+    }
+#endif
+
+#ifdef DfMiniMp3Stats
+    void recordClipGap(uint8_t command)
+    {
+        switch (command)
+        {
+        case Mp3_Commands_PlayNextTrack:
+        case Mp3_Commands_PlayGlobalTrack:
+        case Mp3_Commands_PlayFolderTrack:
+        case Mp3_Commands_PlayMp3FolderTrack:
+        case Mp3_Commands_PlayFolderTrack16:
+            if (_isTrackFinished)
+            {
+                uint32_t gap = micros() - _trackFinished;
+
+                _isTrackFinished = false;
+                _clipGapStats.gaps++;
+                _clipGapStats.gapTotal += gap;
+                if (gap > _clipGapStats.gapMax)
+                {
+                    _clipGapStats.gapMax = gap;
+                }
+                _clipGapStats.gapHistogram[DfMp3_HistogramBucket(gap / 1000)]++;
+            }
+            break;
+        }
+    }
+
+    template <class T_STREAM> static void printHistogram(T_STREAM& out, const uint16_t* histogram)
+    {
+        out.print("[");
+        for (uint8_t bucket = 0; bucket < DfMp3_HistogramBuckets; bucket++)
+        {
+            if (bucket)
+            {
+                out.print(",");
+            }
+            out.print(histogram[bucket]);
+        }
+        out.print("]");
+    }
+#endif
+
+    void logReceived([[maybe_unused]] const uint8_t* data, [[maybe_unused]] uint8_t dataSize)
+    {
+#ifdef DfMiniMp3Trace
+        tracePacket(DfMp3_TraceDirection_In, data, dataSize);
+#endif
+
+#if defined(DfMiniMp3Debug) && (DfMiniMp3DebugLevel >= DfMp3_DebugLevel_Packet)
+        _log.logPacket(Mp3_LogEvent_PacketIn, data, dataSize);
+#endif
+    }
+
+    // the trace is a faithful record of the wire, so the bytes 
+    // dropped before a start code are logged too
+    void logNoise(const uint8_t* noise, uint8_t* noiseSize)
+    {
+        if (*noiseSize)
+        {
+            logReceived(noise, *noiseSize);
+            *noiseSize = 0;
+        }
+    }
+
+    bool readPacket(reply_t* reply)
+    {
+        typename T_CHIP_VARIANT::ReceptionPacket in;
+        uint8_t* inBytes = reinterpret_cast<uint8_t*>(&in);
+        uint8_t read;
+        uint16_t discarded = 0;
+        // bytes skipped while syncing, logged a packet's worth at a time
+        uint8_t noise[sizeof(in)];
+        uint8_t noiseSize = 0;
+
+        // init our out args always
+        *reply = {};
+
+        // try to sync our reads to the packet start
+        do
+        {
+            // we use readBytes as it gives us the standard timeout
+            read = _serial.readBytes(&in.startCode, 1);
+
+            if (read != 1)
+            {
+                // nothing read
+                logNoise(noise, &noiseSize);
+                reply->arg = DfMp3_Error_RxTimeout;
+#ifdef DfMiniMp3Stats
+                _receptionStats.timeouts++;
+                _receptionStats.bytesDiscarded += discarded;
+#endif
+                return false;
+            }
+
+            if (in.startCode != Mp3_PacketStartCode)
+            {
+                discarded++;
+                noise[noiseSize++] = in.startCode;
+                if (noiseSize == sizeof(noise))
+                {
+                    logNoise(noise, &noiseSize);
+                }
+                if (discarded >= c_MaxSyncDiscard)
+                {
+                    // a stream of noise, give the caller a chance to
+                    // do something else, the next read will continue
+                    logNoise(noise, &noiseSize);
+                    reply->arg = DfMp3_Error_PacketHeader;
+#ifdef DfMiniMp3Stats
+                    _receptionStats.errorsHeader++;
+                    _receptionStats.bytesDiscarded += discarded;
+#endif
+                    return false;
+                }
+            }
+        } while (in.startCode != Mp3_PacketStartCode);
+
+        logNoise(noise, &noiseSize);
+
+        read += _serial.readBytes(&in.version, sizeof(in) - 1);
+        logReceived(inBytes, read);
+
+        for (;;)
+        {
+            if (read < sizeof(in))
+            {
+                // not enough bytes, corrupted packet
+                reply->arg = DfMp3_Error_PacketSize;
+#ifdef DfMiniMp3Stats
+                _receptionStats.errorsSize++;
+                _receptionStats.bytesDiscarded += discarded + read;
+#endif
+                return false;
+            }
+
+            if (in.version != Mp3_PacketVersion ||
+                in.length != 0x06 ||
+                in.endCode != Mp3_PacketEndCode)
+            {
+                // invalid version or corrupted packet
+                reply->arg = DfMp3_Error_PacketHeader;
+            }
+            else if (!T_CHIP_VARIANT::validateChecksum(in))
+            {
+                // checksum failed, corrupted packet
+                reply->arg = DfMp3_Error_PacketChecksum;
+            }
+            else
+            {
+                break;
+            }
+
+#ifdef DfMiniMp3Stats
+            if (reply->arg == DfMp3_Error_PacketHeader)
+            {
+                _receptionStats.errorsHeader++;
+            }
+            else
+            {
+                _receptionStats.errorsChecksum++;
+            }
+#endif
+
+            // the start code we synced on may have been noise,
+            // so a real packet may begin within what was read,
+            // look for it rather than dropping it too
+            uint8_t next = 1;
+
+            while (next < read && inBytes[next] != Mp3_PacketStartCode)
+            {
+                next++;
+            }
+            discarded += next;
+
+            if (next >= read)
+            {
+#ifdef DfMiniMp3Stats
+                _receptionStats.bytesDiscarded += discarded;
+#endif
+                return false;
+            }
+
+            if (discarded >= c_MaxSyncDiscard)
+            {
+                // noise full of start codes, what is left goes too
+                reply->arg = DfMp3_Error_PacketHeader;
+#ifdef DfMiniMp3Stats
+                _receptionStats.bytesDiscarded += discarded + read - next;
+#endif
+                return false;
+            }
+
+            read -= next;
+            memmove(inBytes, inBytes + next, read);
+
+            uint8_t more = _serial.readBytes(inBytes + read, sizeof(in) - read);
+            logReceived(inBytes + read, more);
+            read += more;
+
+            reply->arg = 0;
+#ifdef DfMiniMp3Stats
+            _receptionStats.resyncs++;
+#endif
+        }
+
+#ifdef DfMiniMp3Stats
+        _receptionStats.packets++;
+        _receptionStats.bytesDiscarded += discarded;
+#endif
+
+        reply->command = in.command;
+        reply->arg = ((static_cast<uint16_t>(in.hiByteArgument) << 8) | in.lowByteArgument);
+#ifdef DfMiniMp3Stats
+        reply->received = millis();
+#endif
+
+        return true;
+    }
+
+    reply_t retryCommand(SendPacket packet, uint8_t expectedCommand)
+    {
+        LockGuard guard(*this);
+        uint8_t command = packet.command;
+        uint8_t packetSize = T_CHIP_VARIANT::toWire(&packet);
+        reply_t reply;
+#ifdef DfMiniMp3NoRetries
+        const uint8_t comRetries = 1;
+#else
+        const uint8_t comRetries = _comRetries;
+#endif
+        uint8_t retries = comRetries;
+
+#ifdef DfMiniMp3PowerManagement
+        wakeFor(command);
+#endif
+        DfMp3_SpanBegin(DfMp3_Span_Transaction, command);
+
+#ifdef DfMiniMp3Debug
+        if (_inTransaction != 0)
+        {
+#if (DfMiniMp3DebugLevel >= DfMp3_DebugLevel_Error)
+            _log.logValue(Mp3_LogEvent_Reentrant, _inTransaction);
+#endif
+        }
+        else
+#endif
+        {
+            DfMp3_SpanBegin(DfMp3_Span_Drain, command);
+            drainResponses();
+            DfMp3_SpanEnd(DfMp3_Span_Drain, command, 0);
         }
 
 #ifdef DfMiniMp3Debug
         _inTransaction++;
+#endif
+#ifndef DfMiniMp3NoStateTracking
+        transaction_t outer = _transaction;
+        play_t lastPlay = _lastPlay;
+        bool wasPlaybackExpected = _isPlaybackExpected;
+
+        _transaction.command = command;
+#endif
+#ifdef DfMiniMp3Stats
+        uint32_t started = micros();
 #endif
         if (T_CHIP_VARIANT::commandSupportsAck(command))
         {
@@ -558,10 +2533,16 @@ private:
             _serial.setTimeout(c_AckTimeout);             
             do
             {
-                sendPacket(command, arg, requestAck);
-                reply = listenForReply(expectedCommand);
+                reply = exchangePacket(packet, packetSize, expectedCommand, retries != comRetries);
                 retries--;
             } while (reply.command != expectedCommand && retries);
+
+#ifdef DfMiniMp3Stats
+            if (reply.command != expectedCommand && reply.command != Mp3_Replies_Error)
+            {
+                _transactionStats.failures++;
+            }
+#endif
         }
         else
         {
@@ -571,73 +2552,279 @@ private:
             _serial.setTimeout(c_NoAckTimeout);
             do
             {
-                sendPacket(command, arg, requestAck);
-                reply = listenForReply(expectedCommand);
+                reply = exchangePacket(packet, packetSize, expectedCommand, retries != comRetries);
                 retries--;
             } while (reply.command == Mp3_Replies_Error && retries);
         }
 #ifdef DfMiniMp3Debug
         _inTransaction--;
 #endif
+#ifndef DfMiniMp3NoStateTracking
+        _transaction = outer;
+        if (reply.command == Mp3_Replies_Error ||
+            (T_CHIP_VARIANT::commandSupportsAck(command) && reply.command != expectedCommand))
+        {
+            notePlaybackFailed(command, lastPlay, wasPlaybackExpected);
+        }
+#endif
+#ifdef DfMiniMp3Stats
+        uint32_t latency = micros() - started;
+
+        _transactionStats.transactions++;
+        _transactionStats.latencyTotal += latency;
+        if (latency > _transactionStats.latencyMax)
+        {
+            _transactionStats.latencyMax = latency;
+        }
+        _transactionStats.latencyHistogram[DfMp3_HistogramBucket(latency / 1000)]++;
+#endif
 
         if (reply.command == Mp3_Replies_Error)
         {
+#ifdef DfMiniMp3Stats
+            _transactionStats.errors++;
+            _notificationReceived = reply.received;
+#endif
+#ifndef DfMiniMp3NoNotifications
+            enterNotification();
             T_NOTIFICATION_METHOD::OnError(*this, reply.arg);
+            leaveNotification();
+#endif
             reply = {};
         }
-        
+
+        DfMp3_SpanEnd(DfMp3_Span_Transaction, command, reply.command);
+        return reply;
+    }
+
+    reply_t exchangePacket(const SendPacket& packet, 
+            uint8_t packetSize, 
+            uint8_t expectedCommand, 
+            [[maybe_unused]] bool isRetry)
+    {
+        reply_t reply;
+
+        if (isRetry)
+        {
+            DfMp3_SpanInstant(DfMp3_Span_Retry, packet.command);
+        }
+
+        DfMp3_SpanBegin(DfMp3_Span_Send, packet.command);
+        sendPacket(packet, packetSize);
+        DfMp3_SpanEnd(DfMp3_Span_Send, packet.command, 0);
+
+        DfMp3_SpanBegin(DfMp3_Span_Wait, packet.command);
+        reply = listenForReply(expectedCommand);
+        DfMp3_SpanEnd(DfMp3_Span_Wait, packet.command, reply.command);
+
+        return reply;
+    }
+
+    // sends the packet as is, regardless of T_CHIP_VARIANT, 
+    // trying again only when nothing was read
+    template <class T_PACKET> reply_t probeCommand(const T_PACKET& packet, uint8_t expectedCommand)
+    {
+        reply_t reply;
+        uint8_t retries = 2;
+
+        do
+        {
+            sendPacket(packet);
+            reply = listenForReply(expectedCommand);
+            retries--;
+        } while (reply.command == Mp3_Commands_None && retries);
+
         return reply;
     }
 
     reply_t getCommand(uint8_t command, uint16_t arg = 0)
     {
-        return retryCommand(command, command, arg);
+#ifdef DfMiniMp3NoQueries
+        static_assert(sizeof(T_SERIAL_METHOD) == 0, "queries are compiled out by DfMiniMp3NoQueries");
+#endif
+        // a query sees the actions issued before it
+        runPendingCommands();
+#ifdef DfMiniMp3QueryCache
+        return sharedCommand(T_CHIP_VARIANT::generatePacket(command, arg), arg, 0, false);
+#else
+        return retryCommand(T_CHIP_VARIANT::generatePacket(command, arg), command);
+#endif
     }
 
     void setCommand(uint8_t command, uint16_t arg = 0)
     {
-        retryCommand(command, Mp3_Replies_Ack, arg, true);
+        LockGuard guard(*this);
+
+        if (deferCommand(command, arg))
+        {
+            return;
+        }
+        retryCommand(T_CHIP_VARIANT::generatePacket(command, arg, true), Mp3_Replies_Ack);
+    }
+
+    // for commands known at compile time the packet is generated
+    // by the compiler and kept in flash, only a non zero argument 
+    // and its checksum is patched at runtime
+    template <uint8_t C_COMMAND> reply_t getCommand(uint16_t arg = 0, 
+            [[maybe_unused]] uint32_t maxAge = 0, 
+            [[maybe_unused]] bool isCacheable = false)
+    {
+        static const SendPacket c_packet Mp3_ProgMem = T_CHIP_VARIANT::generatePacket(C_COMMAND, 0);
+
+        // a query sees the actions issued before it
+        runPendingCommands();
+#ifdef DfMiniMp3QueryCache
+        return sharedCommand(loadPacket(&c_packet, arg), arg, maxAge, isCacheable);
+#else
+        return retryCommand(loadPacket(&c_packet, arg), C_COMMAND);
+#endif
     }
 
-    reply_t listenForReply(uint8_t command)
+#ifdef DfMiniMp3QueryCache
+    // single flight, a caller waiting on the lock while the same query
+    // is in flight takes its reply rather than asking again
+    reply_t sharedCommand(const SendPacket& packet, uint16_t arg, uint32_t maxAge, bool isCacheable)
     {
+#ifdef Mp3_QueryCompletionsAtomic
+        // read before the lock, any query completing after it 
+        // was in flight as this was asked
+        uint16_t arrived = _queryCompletions.load();
+        LockGuard guard(*this);
+#else
+        // only read under the lock, so only maxAge shares a reply
+        LockGuard guard(*this);
+        uint16_t arrived = _queryCompletions;
+#endif
+        uint8_t command = packet.command;
+        shared_t* shared = findSharedQuery(command, arg);
         reply_t reply;
 
-        while (readPacket(&reply))
+        if (shared != nullptr && 
+            (static_cast<int16_t>(shared->completion - arrived) > 0 ||
+            (maxAge != 0 && (millis() - shared->completed) <= maxAge)))
+        {
+#ifdef DfMiniMp3Stats
+            _transactionStats.shared++;
+#endif
+            reply.command = command;
+            reply.arg = shared->reply;
+            return reply;
+        }
+
+        reply = retryCommand(packet, command);
+        if (reply.command == command)
         {
-            switch (reply.command)
+            if (shared == nullptr)
             {
-            case Mp3_Replies_PlaySource_Online: // play source online
-            case Mp3_Replies_PlaySource_Inserted: // play source inserted
-            case Mp3_Replies_PlaySource_Removed: // play source removed
-                _isOnline = true;
-                appendNotification(reply);
-                break;
+                shared = oldestSharedQuery();
+            }
+            shared->command = command;
+            shared->isCacheable = isCacheable;
+            shared->arg = arg;
+            shared->reply = reply.arg;
+            shared->completed = millis();
+            shared->completion = ++_queryCompletions;
+        }
+        return reply;
+    }
 
-            case Mp3_Replies_TrackFinished_Usb: // usb
-            case Mp3_Replies_TrackFinished_Sd: // micro sd
-            case Mp3_Replies_TrackFinished_Flash: // flash
-                appendNotification(reply);
-                break;
+    shared_t* findSharedQuery(uint8_t command, uint16_t arg)
+    {
+        for (uint8_t index = 0; index < DfMiniMp3QueryCache; index++)
+        {
+            shared_t* shared = &_sharedQueries[index];
 
-            case Mp3_Replies_Error: // error
-                if (command == Mp3_Commands_None)
-                {
-                    appendNotification(reply);
-                }
-                else
-                {
-                    return reply;
-                }
-                break;
+            if (shared->command == command && shared->arg == arg)
+            {
+                return shared;
+            }
+        }
+        return nullptr;
+    }
 
-            case Mp3_Replies_Ack: // ack
-            default:
-                if (command != Mp3_Commands_None)
-                {
-                    return reply;
-                }
-                break;
+    // an unused one if any
+    shared_t* oldestSharedQuery()
+    {
+        shared_t* oldest = &_sharedQueries[0];
+
+        for (uint8_t index = 1; index < DfMiniMp3QueryCache && oldest->command != Mp3_Commands_None; index++)
+        {
+            shared_t* shared = &_sharedQueries[index];
+
+            if (shared->command == Mp3_Commands_None ||
+                static_cast<int16_t>(shared->completion - oldest->completion) < 0)
+            {
+                oldest = shared;
+            }
+        }
+        return oldest;
+    }
+
+    void forgetSharedQueries(bool includeCacheable)
+    {
+        for (uint8_t index = 0; index < DfMiniMp3QueryCache; index++)
+        {
+            if (includeCacheable || !_sharedQueries[index].isCacheable)
+            {
+                _sharedQueries[index].command = Mp3_Commands_None;
+            }
+        }
+    }
+#endif
+
+    template <uint8_t C_COMMAND> void setCommand(uint16_t arg = 0)
+    {
+        static const SendPacket c_packet Mp3_ProgMem = T_CHIP_VARIANT::generatePacket(C_COMMAND, 0, true);
+        LockGuard guard(*this);
+
+        if (deferCommand(C_COMMAND, arg))
+        {
+            return;
+        }
+        retryCommand(loadPacket(&c_packet, arg), Mp3_Replies_Ack);
+    }
+
+    // for commands that are never acked, nothing is waited for
+    template <uint8_t C_COMMAND> void sendOnly(uint16_t arg = 0)
+    {
+        static const SendPacket c_packet Mp3_ProgMem = T_CHIP_VARIANT::generatePacket(C_COMMAND, 0);
+        LockGuard guard(*this);
+
+        if (deferCommand(C_COMMAND, arg, true))
+        {
+            return;
+        }
+
+        SendPacket packet = loadPacket(&c_packet, arg);
+
+#ifdef DfMiniMp3PowerManagement
+        wakeFor(C_COMMAND);
+#endif
+        drainResponses();
+        sendPacket(packet, T_CHIP_VARIANT::toWire(&packet));
+    }
+
+    static SendPacket loadPacket(const SendPacket* stored, uint16_t arg)
+    {
+        SendPacket packet;
+
+        Mp3_ProgMemCopy(&packet, stored, sizeof(packet));
+        if (arg)
+        {
+            T_CHIP_VARIANT::setArgument(&packet, arg);
+        }
+        return packet;
+    }
+
+    reply_t listenForReply(uint8_t command)
+    {
+        reply_t reply;
+
+        while (readPacket(&reply))
+        {
+            if (takeReply(reply, command))
+            {
+                return reply;
             }
 
             // for not specific listen, only drain
@@ -648,23 +2835,86 @@ private:
             }
         }
 
-
         return {};
     }
 
-#ifdef DfMiniMp3Debug
-    void printRawPacket(const uint8_t* data, size_t dataSize)
+    // true when the reply is the answer to command, anything else
+    // is tracked and queued as a notification
+    bool takeReply(const reply_t& reply, uint8_t command)
     {
-        char formated[8];
-        const uint8_t* end = data + dataSize;
-
-        while (data < end)
+        switch (reply.command)
         {
-            sprintf(formated, " %02x", *data);
-            DfMiniMp3Debug.print(formated);
-            data++;
-        }
-    }
+        case Mp3_Replies_PlaySource_Online: // play source online
+#ifdef DfMiniMp3NoStateTracking
+            if (command == Mp3_Commands_GetPlaySources)
+            {
+                return true;
+            }
+#else
+            if (command == Mp3_Commands_GetPlaySources && 
+                _transaction.command == Mp3_Commands_GetPlaySources &&
+                (millis() - _transaction.sent) <= T_CHIP_VARIANT::playSourcesReplyWindow())
+            {
+                // same code, but in reply to our request
+                return true;
+            }
+            _playSources = reply.arg;
+#endif
+            _isOnline = true;
+            noteMedia(reply);
+            break;
+
+        case Mp3_Replies_PlaySource_Inserted: // play source inserted
+#ifndef DfMiniMp3NoStateTracking
+            _playSources |= reply.arg;
+#endif
+            _isOnline = true;
+            noteMedia(reply);
+            break;
+
+        case Mp3_Replies_PlaySource_Removed: // play source removed
+#ifndef DfMiniMp3NoStateTracking
+            _playSources &= ~reply.arg;
+#endif
+            _isOnline = true;
+            noteMedia(reply);
+            break;
+
+        case Mp3_Replies_TrackFinished_Usb: // usb
+        case Mp3_Replies_TrackFinished_Sd: // micro sd
+        case Mp3_Replies_TrackFinished_Flash: // flash
+            noteTrackFinished(reply.arg);
+            stageNextClip();
+            appendNotification(reply);
+            break;
+
+        case Mp3_Replies_Error: // error
+            if (command == Mp3_Commands_None)
+            {
+                appendNotification(reply);
+            }
+            else
+            {
+                return true;
+            }
+            break;
 
+        case Mp3_Replies_Ack: // ack
+#ifdef DfMiniMp3TrackDurations
+            if (command != Mp3_Commands_None && isTrackStart(_transaction.command))
+            {
+                // timed from the ack when there is one
+                _trackStarted = millis();
+            }
 #endif
+            // fall through
+        default:
+            if (command != Mp3_Commands_None)
+            {
+                return true;
+            }
+            break;
+        }
+        return false;
+    }
 };
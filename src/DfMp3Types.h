@@ -107,3 +107,276 @@ struct DfMp3_Status
     DfMp3_StatusState state;
 };
 
+
+// bitfield - event filter masks for Mp3NotificationBus
+enum DfMp3_EventType
+{
+    DfMp3_EventType_PlayFinished = 0x01,
+    DfMp3_EventType_PlaySourceOnline = 0x02,
+    DfMp3_EventType_PlaySourceInserted = 0x04,
+    DfMp3_EventType_PlaySourceRemoved = 0x08,
+    DfMp3_EventType_PlaySource = 0x0e, // any of online, inserted and removed
+    DfMp3_EventType_Error = 0x10,
+    DfMp3_EventType_All = 0x1f
+};
+
+struct DfMp3_Event
+{
+    DfMp3_EventType type; // only one bit set
+    DfMp3_PlaySources source; // not used by errors
+    uint16_t arg; // track for play finished, code for errors
+    uint32_t received; // millis() when read from the module, DfMiniMp3Stats only
+};
+
+// the T_CHIP_VARIANT classes, as identified by probeChipVariant()
+enum DfMp3_ChipVariant
+{
+    DfMp3_ChipVariant_Original, // Mp3ChipOriginal
+    DfMp3_ChipVariant_MH2024K16SS, // Mp3ChipMH2024K16SS
+    DfMp3_ChipVariant_IncongruousNoAck, // Mp3ChipIncongruousNoAck
+    DfMp3_ChipVariant_Count
+};
+
+// parts of a transaction reported to DfMiniMp3SpanTracer
+enum DfMp3_Span
+{
+    DfMp3_Span_Transaction, // a whole command, result is the reply command
+    DfMp3_Span_Drain, // handling what arrived before the command
+    DfMp3_Span_Send, // writing the packet
+    DfMp3_Span_Wait, // waiting for the reply, result is the reply command, zero on timeout
+    DfMp3_Span_Notification, // calling a notification method, command is the notification
+    DfMp3_Span_Retry, // instant, the packet is about to be sent again
+};
+
+enum DfMp3_TraceDirection
+{
+    DfMp3_TraceDirection_Out, // sent to the module
+    DfMp3_TraceDirection_In,  // received from the module
+};
+
+// one raw packet as seen on the wire, see DfMiniMp3Trace
+// dumpTrace() writes these as is (16 bytes, little endian timestamp)
+struct DfMp3_TraceRecord
+{
+    uint32_t timestamp; // micros() when written or read
+    uint8_t direction; // DfMp3_TraceDirection
+    uint8_t length; // valid bytes in data, short reads are kept
+    uint8_t data[10];
+};
+
+// reception path counters, see DfMiniMp3Stats
+struct DfMp3_ReceptionStats
+{
+    uint32_t packets; // valid packets decoded
+    uint32_t bytesDiscarded; // bytes dropped while looking for a valid packet
+    uint16_t resyncs; // packet start found inside a rejected packet
+    uint16_t timeouts; // nothing more to read
+    uint16_t errorsSize; // truncated packets
+    uint16_t errorsHeader; // bad version, length or end code
+    uint16_t errorsChecksum;
+};
+
+// histogram buckets are powers of two in milliseconds,
+// bucket 0 is under 8ms, bucket 1 under 16ms, ... the last is everything over
+const uint8_t DfMp3_HistogramBuckets = 8;
+
+inline uint8_t DfMp3_HistogramBucket(uint32_t ms)
+{
+    uint8_t bucket = 0;
+
+    ms >>= 3;
+    while (ms && bucket < (DfMp3_HistogramBuckets - 1))
+    {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// transaction counters, see DfMiniMp3Stats
+struct DfMp3_TransactionStats
+{
+    uint32_t transactions; // commands completed
+    uint32_t sends; // packets sent, including retries
+    uint32_t shared; // queries answered without sending, see DfMiniMp3QueryCache
+    uint16_t failures; // expected reply never arrived
+    uint16_t errors; // module replied with an error
+    uint32_t latencyTotal; // micros, from first send to reply
+    uint32_t latencyMax; // micros
+    uint16_t latencyHistogram[DfMp3_HistogramBuckets];
+    uint32_t notifications; // notifications called
+    uint32_t notificationTime; // micros spent in notification methods
+    uint32_t dwellMax; // ms, longest a notification waited in the queue
+    uint16_t dwellHistogram[DfMp3_HistogramBuckets]; // ms waited in the queue
+};
+
+// gaps between a track finishing and the next play command, see DfMiniMp3Stats
+struct DfMp3_ClipGapStats
+{
+    uint32_t gaps; // play commands sent after a track finished
+    uint32_t gapTotal; // micros
+    uint32_t gapMax; // micros
+    uint16_t gapHistogram[DfMp3_HistogramBuckets]; // ms
+};
+
+// what a DfMp3_Clip plays, see playClip()
+enum DfMp3_ClipKind
+{
+    DfMp3_ClipKind_Folder, // sd:/##/###, arg is (folder << 8) | track
+    DfMp3_ClipKind_Folder16, // sd:/##/####, arg is (folder << 12) | track
+    DfMp3_ClipKind_Mp3, // sd:/mp3/####, arg is track
+    DfMp3_ClipKind_Advert // sd:/advert/####, arg is track
+};
+
+// a clip with its command argument already encoded, as generated
+// by extras/Mp3MediaManifest
+struct DfMp3_Clip
+{
+    uint8_t kind; // DfMp3_ClipKind
+    uint16_t arg;
+};
+
+// FNV-1a over the track counts of the media, values are added low 
+// byte first, extras/Mp3MediaManifest computes the same
+const uint32_t DfMp3_MediaHashSeed = 2166136261UL;
+
+inline uint32_t DfMp3_MediaHashAdd(uint32_t hash, uint16_t value)
+{
+    hash = (hash ^ (value & 0xff)) * 16777619UL;
+    return (hash ^ (value >> 8)) * 16777619UL;
+}
+
+// CRC-16/CCITT-FALSE
+inline uint16_t DfMp3_Crc16(const uint8_t* data, size_t size)
+{
+    uint16_t crc = 0xffff;
+
+    while (size--)
+    {
+        crc ^= static_cast<uint16_t>(*data++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+// changed when DfMp3_Snapshot changes, older snapshots are then invalid
+const uint8_t DfMp3_SnapshotVersion = 2;
+
+// module and media state kept across a restart, see saveSnapshot()
+struct DfMp3_Snapshot
+{
+    uint8_t version; // DfMp3_SnapshotVersion
+    uint8_t size; // sizeof(DfMp3_Snapshot)
+    uint8_t volume;
+    uint8_t eq; // DfMp3_Eq
+    uint8_t playbackMode; // DfMp3_PlaybackMode
+    uint8_t playSource; // DfMp3_PlaySource the tracks are counted on
+    uint8_t playSources; // DfMp3_PlaySources online
+    uint8_t playCommand; // last play command sent, zero when none
+    uint16_t playArg;
+    uint16_t totalTrackCount; // media fingerprint, 
+    uint16_t totalFolderCount; // along with totalTrackCount
+    uint16_t crc; // of all the above
+};
+
+inline uint16_t DfMp3_SnapshotCrc(const DfMp3_Snapshot& snapshot)
+{
+    return DfMp3_Crc16(reinterpret_cast<const uint8_t*>(&snapshot), 
+            sizeof(DfMp3_Snapshot) - sizeof(snapshot.crc));
+}
+
+enum DfMp3_SnapshotResult
+{
+    DfMp3_SnapshotResult_Restored,
+    DfMp3_SnapshotResult_NotFound, // the storage read failed
+    DfMp3_SnapshotResult_Invalid, // other version, size or crc
+    DfMp3_SnapshotResult_MediaChanged
+};
+
+// storage callbacks for saveSnapshot() and loadSnapshot(), 
+// context is passed through for the sketch's use
+typedef bool (*DfMp3_SnapshotWrite)(const uint8_t* data, size_t size, void* context);
+typedef bool (*DfMp3_SnapshotRead)(uint8_t* data, size_t size, void* context);
+
+// counters of Mp3PlaybackWatchdog
+struct DfMp3_WatchdogStats
+{
+    uint32_t polls; // status queries made
+    uint16_t pollFailures; // status queries without a reply, not stalls
+    uint16_t stalls; // playback expected but found stopped
+    uint16_t recoveredByStart;
+    uint16_t recoveredByReplay;
+    uint16_t recoveredByReset;
+    uint16_t unrecovered; // every step tried without playback resuming
+    uint32_t recoveryTimeTotal; // ms, from the stall found to playing again
+    uint32_t recoveryTimeMax; // ms
+};
+
+enum DfMp3_AsyncStatus
+{
+    DfMp3_AsyncStatus_Idle, // not queued
+    DfMp3_AsyncStatus_Queued,
+    DfMp3_AsyncStatus_Pending, // sent, waiting for the ack or reply
+    DfMp3_AsyncStatus_Done,
+    DfMp3_AsyncStatus_Failed, // no reply after all retries, or an error
+    DfMp3_AsyncStatus_Cancelled // by cancelAsync() of its lane
+};
+
+// the lanes of queueAsync(), a request is sent ahead of those queued
+// in the lanes below it, and in order within its own
+enum DfMp3_AsyncLane
+{
+    DfMp3_AsyncLane_Realtime, // stop, pause and adverts
+    DfMp3_AsyncLane_Interactive, // play, volume and the other actions
+    DfMp3_AsyncLane_Background, // queries
+    DfMp3_AsyncLane_Auto // picked from the command as listed above
+};
+
+// a command run by DFMiniMp3::queueAsync(), owned by the caller and
+// left untouched by it until complete is called
+struct DfMp3_AsyncRequest
+{
+    uint8_t command;
+    uint8_t flags; // Mp3_CommandFlags
+    uint16_t arg;
+    uint8_t status; // DfMp3_AsyncStatus
+    uint8_t lane; // DfMp3_AsyncLane
+    uint16_t result; // reply argument when done, error code when failed
+    void (*complete)(DfMp3_AsyncRequest* request); // may be nullptr
+    void* context; // for the caller's use
+    DfMp3_AsyncRequest* next; // the queue link
+};
+
+// a track play time learned with DfMiniMp3TrackDurations, keyed by
+// the play command and argument that started it; tracks reached by
+// next, loop or random are keyed as Mp3_Commands_PlayGlobalTrack with
+// the global track number the module reported finished
+struct DfMp3_TrackDuration
+{
+    uint16_t arg;
+    uint16_t duration; // in 100ms, up to 109 minutes
+    uint8_t command;
+};
+
+// changed when the saved track durations change, older ones are then invalid
+const uint8_t DfMp3_TrackDurationsVersion = 1;
+
+// power use with DfMiniMp3PowerManagement
+struct DfMp3_PowerStats
+{
+    uint16_t sleeps;
+    uint16_t wakes; // awake() or enableDac() sent ahead of a command
+    uint32_t wakeLatencyTotal; // micros, of those wakes
+    uint32_t wakeLatencyMax; // micros
+    uint32_t sleepTime; // ms asleep, up to the last wake
+};
+
+// media reports with DfMiniMp3MediaDebounce
+struct DfMp3_MediaStats
+{
+    uint32_t events; // online, inserted and removed reports read
+    uint32_t suppressed; // of those, collapsed into another or cancelled out
+};
@@ -0,0 +1,108 @@
+/*-------------------------------------------------------------------------
+Mp3ChipAutoDetect - chip class for T_CHIP_VARIANT template features
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// For modules of unknown origin, call probeChipVariant() once after 
+// begin() and it will bind to the behavior of one of the other chip 
+// classes through a small table.  Until then it acts as Mp3ChipOriginal.
+//
+// The state is per class, so when more than one module is used 
+// give each its own C_INSTANCE
+// DFMiniMp3<HardwareSerial, Mp3Notify, Mp3ChipAutoDetect<0>> mp3a(Serial1);
+// DFMiniMp3<HardwareSerial, Mp3Notify, Mp3ChipAutoDetect<1>> mp3b(Serial2);
+//
+template <uint8_t C_INSTANCE = 0> class Mp3ChipAutoDetect : public Mp3ChipBase
+{
+public:
+    // packets are generated with a checksum and it is
+    // removed when sending if the bound chip doesn't want it
+    typedef Mp3_Packet_WithCheckSum SendPacket;
+    typedef Mp3_Packet_WithCheckSum ReceptionPacket;
+
+    static constexpr SendPacket generatePacket(uint8_t command, uint16_t arg, bool requestAck = false)
+    {
+        return Mp3ChipOriginal::generatePacket(command, arg, requestAck);
+    }
+
+    static uint8_t toWire(SendPacket* packet)
+    {
+        if (s_chip->sendCheckSum)
+        {
+            return sizeof(Mp3_Packet_WithCheckSum);
+        }
+        
+        // same layout up to the checksum
+        reinterpret_cast<Mp3_Packet_WithoutCheckSum*>(packet)->endCode = packet->endCode;
+        return sizeof(Mp3_Packet_WithoutCheckSum);
+    }
+
+    static bool commandSupportsAck(uint8_t command)
+    {
+        return s_chip->commandSupportsAck(command);
+    }
+
+    static uint16_t playSourcesReplyWindow()
+    {
+        return s_chip->playSourcesReplyWindow;
+    }
+
+    static void setVariant(DfMp3_ChipVariant variant)
+    {
+        if (variant < DfMp3_ChipVariant_Count)
+        {
+            s_chip = &c_chips[variant];
+        }
+    }
+
+    static DfMp3_ChipVariant getVariant()
+    {
+        return static_cast<DfMp3_ChipVariant>(s_chip - c_chips);
+    }
+
+private:
+    struct chip_t
+    {
+        bool sendCheckSum;
+        bool (*commandSupportsAck)(uint8_t command);
+        uint16_t playSourcesReplyWindow;
+    };
+
+    static const chip_t c_chips[DfMp3_ChipVariant_Count];
+    static const chip_t* s_chip;
+};
+
+// indexed by DfMp3_ChipVariant
+template <uint8_t C_INSTANCE> 
+const typename Mp3ChipAutoDetect<C_INSTANCE>::chip_t Mp3ChipAutoDetect<C_INSTANCE>::c_chips[DfMp3_ChipVariant_Count] =
+{
+    { Mp3ChipOriginal::SendCheckSum, Mp3ChipOriginal::commandSupportsAck, Mp3ChipOriginal::playSourcesReplyWindow() },
+    { Mp3ChipMH2024K16SS::SendCheckSum, Mp3ChipMH2024K16SS::commandSupportsAck, Mp3ChipMH2024K16SS::playSourcesReplyWindow() },
+    { Mp3ChipIncongruousNoAck::SendCheckSum, Mp3ChipIncongruousNoAck::commandSupportsAck, Mp3ChipIncongruousNoAck::playSourcesReplyWindow() },
+};
+
+template <uint8_t C_INSTANCE>
+const typename Mp3ChipAutoDetect<C_INSTANCE>::chip_t* Mp3ChipAutoDetect<C_INSTANCE>::s_chip = 
+    &Mp3ChipAutoDetect<C_INSTANCE>::c_chips[DfMp3_ChipVariant_Original];
@@ -29,29 +29,82 @@ License along with DFMiniMp3.  If not, see
 
 class Mp3ChipBase
 {
-private:
-    static uint16_t calcChecksum(const Mp3_Packet_WithCheckSum& packet)
+public:
+    // 0 - (version + length + command + requestAck + argument)
+    static constexpr uint16_t calcChecksum(uint8_t command, 
+            uint8_t requestAck, 
+            uint16_t arg, 
+            uint8_t version = Mp3_PacketVersion, 
+            uint8_t length = Mp3_PacketLength)
     {
-        uint16_t sum = 0xFFFF;
-        for (const uint8_t* packetByte = &(packet.version); packetByte != &(packet.hiByteCheckSum); packetByte++)
-        {
-            sum -= *packetByte;
-        }
-        return sum + 1;
+        return static_cast<uint16_t>(0 - (static_cast<uint16_t>(version) + 
+            length + 
+            command + 
+            requestAck + 
+            (arg >> 8) + 
+            (arg & 0xff)));
     }
 
-public:
     static void setChecksum(Mp3_Packet_WithCheckSum* out)
     {
-        uint16_t sum = calcChecksum(*out);
+        uint16_t sum = calcChecksum(out->command, 
+            out->requestAck, 
+            argument(*out), 
+            out->version, 
+            out->length);
+
+        out->hiByteCheckSum = (sum >> 8);
+        out->lowByteCheckSum = (sum & 0xff);
+    }
+
+    static constexpr bool validateChecksum(const Mp3_Packet_WithCheckSum& in)
+    {
+        return (calcChecksum(in.command, 
+                in.requestAck, 
+                argument(in), 
+                in.version, 
+                in.length) == 
+            ((static_cast<uint16_t>(in.hiByteCheckSum) << 8) | in.lowByteCheckSum));
+    }
+
+    // patch the argument into a packet generated with a zero argument,
+    // the checksum only needs the new argument bytes removed
+    static void setArgument(Mp3_Packet_WithCheckSum* out, uint16_t arg)
+    {
+        uint16_t sum = (static_cast<uint16_t>(out->hiByteCheckSum) << 8) | out->lowByteCheckSum;
+        
+        out->hiByteArgument = (arg >> 8);
+        out->lowByteArgument = (arg & 0xff);
 
+        sum -= out->hiByteArgument + out->lowByteArgument;
         out->hiByteCheckSum = (sum >> 8);
         out->lowByteCheckSum = (sum & 0xff);
     }
 
-    static bool validateChecksum(const Mp3_Packet_WithCheckSum& in)
+    static void setArgument(Mp3_Packet_WithoutCheckSum* out, uint16_t arg)
+    {
+        out->hiByteArgument = (arg >> 8);
+        out->lowByteArgument = (arg & 0xff);
+    }
+
+    // how long after sending GetPlaySources a 0x3f is taken 
+    // as the reply rather than the online notification, 
+    // zero if the chip never replies to it
+    static constexpr uint16_t playSourcesReplyWindow()
+    {
+        return 200;
+    }
+
+    // finalize the packet for sending, returns the bytes to write
+    // most chips send the generated packet as is
+    template <class T_PACKET> static constexpr uint8_t toWire([[maybe_unused]] T_PACKET* packet)
+    {
+        return sizeof(T_PACKET);
+    }
+
+private:
+    template <class T_PACKET> static constexpr uint16_t argument(const T_PACKET& packet)
     {
-        uint16_t sum = calcChecksum(in);
-        return (sum == ((static_cast<uint16_t>(in.hiByteCheckSum) << 8) | in.lowByteCheckSum));
+        return (static_cast<uint16_t>(packet.hiByteArgument) << 8) | packet.lowByteArgument;
     }
 };
\ No newline at end of file
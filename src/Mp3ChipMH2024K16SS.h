@@ -35,12 +35,12 @@ public:
     typedef Mp3_Packet_WithoutCheckSum SendPacket;
     typedef Mp3_Packet_WithCheckSum ReceptionPacket;
 
-    static const SendPacket generatePacket(uint8_t command, uint16_t arg, bool requestAck = false)
+    static constexpr SendPacket generatePacket(uint8_t command, uint16_t arg, bool requestAck = false)
     {
         return {
             Mp3_PacketStartCode,
             Mp3_PacketVersion,
-            6, // size: of what?  without checksum this doesn't make sense
+            Mp3_PacketLength, // size: of what?  without checksum this doesn't make sense
             command,
             requestAck,
             static_cast<uint8_t>(arg >> 8),
@@ -52,4 +52,9 @@ public:
     {
         return true;
     }
+
+    static constexpr uint16_t playSourcesReplyWindow()
+    {
+        return 0; // never replies to GetPlaySources
+    }
 };
\ No newline at end of file
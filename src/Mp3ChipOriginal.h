@@ -34,21 +34,19 @@ public:
     typedef Mp3_Packet_WithCheckSum SendPacket;
     typedef Mp3_Packet_WithCheckSum ReceptionPacket;
 
-    static const SendPacket generatePacket(uint8_t command, uint16_t arg, bool requestAck = false)
+    static constexpr SendPacket generatePacket(uint8_t command, uint16_t arg, bool requestAck = false)
     {
-        SendPacket packet = {
+        return {
                 Mp3_PacketStartCode,
                 Mp3_PacketVersion,
-                6, // size, remaining bytes not including end code
+                Mp3_PacketLength, // size, remaining bytes not including end code
                 command,
                 requestAck,
                 static_cast<uint8_t>(arg >> 8),
                 static_cast<uint8_t>(arg & 0x00ff),
-                0, // checksum calculated below
-                0, // checksum calculated below
+                static_cast<uint8_t>(calcChecksum(command, requestAck, arg) >> 8),
+                static_cast<uint8_t>(calcChecksum(command, requestAck, arg) & 0x00ff),
                 Mp3_PacketEndCode };
-        setChecksum(&packet);
-        return packet;
     }
 
     static bool commandSupportsAck([[maybe_unused]] uint8_t command)
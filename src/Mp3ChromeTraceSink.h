@@ -0,0 +1,141 @@
+/*-------------------------------------------------------------------------
+Mp3ChromeTraceSink - DfMiniMp3SpanTracer that writes Chrome trace event JSON
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// For host builds with stdio, the output loads in chrome://tracing 
+// and ui.perfetto.dev.  Timestamps come from micros(), so emulated 
+// time is shown as emulated.
+//
+// #include <Mp3ChromeTraceSink.h>
+// #define DfMiniMp3SpanTracer Mp3ChromeTraceSink
+// #include <DFMiniMp3.h>
+//
+// Mp3ChromeTraceSink::begin(fopen("dfmp3.json", "w"));
+// ... run the workload ...
+// Mp3ChromeTraceSink::end();
+//
+#include <stdio.h>
+#include "DfMp3Types.h"
+
+class Mp3ChromeTraceSink
+{
+public:
+    // tid lets several emulated modules be told apart
+    static void begin(FILE* out, uint8_t tid = 1)
+    {
+        state_t& state = getState();
+
+        state.out = out;
+        state.tid = tid;
+        state.first = true;
+        if (state.out)
+        {
+            fputs("{\"traceEvents\":[\n", state.out);
+        }
+    }
+
+    static void setTid(uint8_t tid)
+    {
+        getState().tid = tid;
+    }
+
+    static void end()
+    {
+        state_t& state = getState();
+
+        if (state.out)
+        {
+            fputs("\n]}\n", state.out);
+            fclose(state.out);
+            state.out = nullptr;
+        }
+    }
+
+    static void OnSpanBegin(DfMp3_Span span, uint8_t command)
+    {
+        writeEvent(span, 'B', command, "");
+    }
+
+    static void OnSpanEnd(DfMp3_Span span, uint8_t command, uint16_t result)
+    {
+        char extra[24];
+
+        snprintf(extra, sizeof(extra), ",\"result\":\"0x%04x\"", result);
+        writeEvent(span, 'E', command, extra);
+    }
+
+    static void OnSpanInstant(DfMp3_Span span, uint8_t command)
+    {
+        writeEvent(span, 'i', command, "");
+    }
+
+private:
+    struct state_t
+    {
+        FILE* out;
+        uint8_t tid;
+        bool first;
+    };
+
+    // function static so this header may be included more than once
+    static state_t& getState()
+    {
+        static state_t state = { nullptr, 1, true };
+        return state;
+    }
+
+    static void writeEvent(DfMp3_Span span, char phase, uint8_t command, const char* extra)
+    {
+        static const char* const c_names[] = 
+        { 
+            "Transaction", 
+            "Drain", 
+            "Send", 
+            "Wait", 
+            "Notification", 
+            "Retry" 
+        };
+        state_t& state = getState();
+
+        if (!state.out)
+        {
+            return;
+        }
+
+        fprintf(state.out, 
+            "%s{\"name\":\"%s\",\"cat\":\"dfmp3\",\"ph\":\"%c\",%s\"ts\":%lu,\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"command\":\"0x%02x\"%s}}",
+            state.first ? "" : ",\n",
+            (static_cast<size_t>(span) < sizeof(c_names) / sizeof(c_names[0])) ? c_names[span] : "Unknown",
+            phase,
+            (phase == 'i') ? "\"s\":\"t\"," : "",
+            static_cast<unsigned long>(micros()),
+            state.tid,
+            command,
+            extra);
+        state.first = false;
+    }
+};
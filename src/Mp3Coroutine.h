@@ -0,0 +1,348 @@
+/*-------------------------------------------------------------------------
+DFMiniMp3 library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// C++20 awaitables for DFMiniMp3 commands, built on queueAsync().
+// Define DfMiniMp3Async before including DFMiniMp3.h and this, in 
+// every file that includes either, so they all see the same class.
+// A coroutine suspends on each command until loop()
+// reads its ack or reply, so several flows across several modules
+// run from the one loop() without blocking or threads.
+//
+// Mp3CoDevice<DfMp3> device(dfmp3);
+// Mp3CoSignal finished; // set() from OnPlayFinished
+//
+// Mp3Task playRandomInFolder(uint8_t folder)
+// {
+//     uint16_t count = co_await device.getFolderTrackCount(folder);
+//     co_await device.playFolderTrack(folder, random(count) + 1);
+//     co_await finished;
+// }
+//
+// commands give true when acked, queries their decoded reply or zero 
+// when none came
+//
+#if !defined(__has_include) || (__cplusplus < 202002L)
+#error "Mp3Coroutine.h needs C++20, build with -std=c++20 or later"
+#elif !__has_include(<coroutine>)
+#error "Mp3Coroutine.h needs <coroutine>, which this toolchain does not provide"
+#endif
+
+#ifndef DfMiniMp3Async
+#error "define DfMiniMp3Async before including DFMiniMp3.h and Mp3Coroutine.h"
+#endif
+
+#include "DFMiniMp3.h"
+#include <coroutine>
+#include <exception>
+
+// the return type of a coroutine that runs until its first co_await
+// when called and then from loop(), its frame is freed as it returns
+class Mp3Task
+{
+public:
+    struct promise_type
+    {
+        Mp3Task get_return_object() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+// something to wait on that is not a command, such as a track finishing;
+// set() resumes the waiting coroutine there and then, or is kept for
+// the next to wait when none is
+class Mp3CoSignal
+{
+public:
+    Mp3CoSignal() :
+        _waiting(),
+        _isSet(false)
+    {
+    }
+
+    Mp3CoSignal(const Mp3CoSignal&) = delete;
+    Mp3CoSignal& operator=(const Mp3CoSignal&) = delete;
+
+    void set()
+    {
+        std::coroutine_handle<> waiting = _waiting;
+
+        if (waiting)
+        {
+            _waiting = {};
+            waiting.resume();
+        }
+        else
+        {
+            _isSet = true;
+        }
+    }
+
+    void clear()
+    {
+        _isSet = false;
+    }
+
+    class Awaiter
+    {
+    public:
+        explicit Awaiter(Mp3CoSignal& signal) :
+            _signal(signal)
+        {
+        }
+
+        bool await_ready() noexcept
+        {
+            bool isSet = _signal._isSet;
+
+            _signal._isSet = false;
+            return isSet;
+        }
+
+        void await_suspend(std::coroutine_handle<> waiting) noexcept
+        {
+            _signal._waiting = waiting;
+        }
+
+        void await_resume() noexcept
+        {
+        }
+
+    private:
+        Mp3CoSignal& _signal;
+    };
+
+    Awaiter operator co_await() noexcept
+    {
+        return Awaiter(*this);
+    }
+
+private:
+    std::coroutine_handle<> _waiting;
+    bool _isSet;
+};
+
+// awaits a command of Mp3CommandDescriptors.h, the command may be given
+// when it depends on the source, T_COMMAND then only types the result
+template <class T_DFMINIMP3, class T_COMMAND> class Mp3CoCommand
+{
+public:
+    Mp3CoCommand(T_DFMINIMP3& mp3, uint16_t arg, uint8_t command = T_COMMAND::Command) :
+        _mp3(mp3),
+        _request(),
+        _waiting()
+    {
+        _request.command = command;
+        _request.flags = T_COMMAND::Flags;
+        _request.arg = arg;
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> waiting)
+    {
+        _waiting = waiting;
+        _request.complete = resume;
+        _request.context = this;
+        _mp3.queueAsync(&_request);
+    }
+
+    auto await_resume() const noexcept
+    {
+        bool isDone = (_request.status == DfMp3_AsyncStatus_Done);
+
+        if constexpr (T_COMMAND::IsQuery)
+        {
+            return T_COMMAND::decode(isDone ? _request.result : 0);
+        }
+        else
+        {
+            return isDone;
+        }
+    }
+
+private:
+    T_DFMINIMP3& _mp3;
+    DfMp3_AsyncRequest _request;
+    std::coroutine_handle<> _waiting;
+
+    static void resume(DfMp3_AsyncRequest* request)
+    {
+        static_cast<Mp3CoCommand*>(request->context)->_waiting.resume();
+    }
+};
+
+// the DFMiniMp3 methods as awaitables, same names and arguments
+template <class T_DFMINIMP3> class Mp3CoDevice
+{
+public:
+    template <class T_COMMAND> using Command = Mp3CoCommand<T_DFMINIMP3, T_COMMAND>;
+
+    explicit Mp3CoDevice(T_DFMINIMP3& mp3) :
+        _mp3(mp3)
+    {
+    }
+
+    T_DFMINIMP3& getMp3()
+    {
+        return _mp3;
+    }
+
+    // any command of Mp3CommandDescriptors.h
+    template <class T_COMMAND> Command<T_COMMAND> command(uint16_t arg = 0)
+    {
+        return Command<T_COMMAND>(_mp3, arg);
+    }
+
+    Command<Mp3_Command_PlayGlobalTrack> playGlobalTrack(uint16_t track = 0)
+    {
+        return command<Mp3_Command_PlayGlobalTrack>(track);
+    }
+
+    Command<Mp3_Command_PlayMp3FolderTrack> playMp3FolderTrack(uint16_t track)
+    {
+        return command<Mp3_Command_PlayMp3FolderTrack>(track);
+    }
+
+    Command<Mp3_Command_PlayFolderTrack> playFolderTrack(uint8_t folder, uint8_t track)
+    {
+        return command<Mp3_Command_PlayFolderTrack>((folder << 8) | track);
+    }
+
+    Command<Mp3_Command_PlayFolderTrack16> playFolderTrack16(uint8_t folder, uint16_t track)
+    {
+        return command<Mp3_Command_PlayFolderTrack16>((static_cast<uint16_t>(folder) << 12) | track);
+    }
+
+    Command<Mp3_Command_PlayAdvertTrack> playAdvertisement(uint16_t track)
+    {
+        return command<Mp3_Command_PlayAdvertTrack>(track);
+    }
+
+    Command<Mp3_Command_StopAdvert> stopAdvertisement()
+    {
+        return command<Mp3_Command_StopAdvert>();
+    }
+
+    Command<Mp3_Command_PlayNextTrack> nextTrack()
+    {
+        return command<Mp3_Command_PlayNextTrack>();
+    }
+
+    Command<Mp3_Command_PlayPrevTrack> prevTrack()
+    {
+        return command<Mp3_Command_PlayPrevTrack>();
+    }
+
+    Command<Mp3_Command_Start> start()
+    {
+        return command<Mp3_Command_Start>();
+    }
+
+    Command<Mp3_Command_Pause> pause()
+    {
+        return command<Mp3_Command_Pause>();
+    }
+
+    Command<Mp3_Command_Stop> stop()
+    {
+        return command<Mp3_Command_Stop>();
+    }
+
+    Command<Mp3_Command_SetVolume> setVolume(uint8_t volume)
+    {
+        return command<Mp3_Command_SetVolume>(volume);
+    }
+
+    Command<Mp3_Command_GetVolume> getVolume()
+    {
+        return command<Mp3_Command_GetVolume>();
+    }
+
+    Command<Mp3_Command_SetEq> setEq(DfMp3_Eq eq)
+    {
+        return command<Mp3_Command_SetEq>(eq);
+    }
+
+    Command<Mp3_Command_GetEq> getEq()
+    {
+        return command<Mp3_Command_GetEq>();
+    }
+
+    Command<Mp3_Command_GetStatus> getStatus()
+    {
+        return command<Mp3_Command_GetStatus>();
+    }
+
+    Command<Mp3_Command_GetFolderTrackCount> getFolderTrackCount(uint16_t folder)
+    {
+        return command<Mp3_Command_GetFolderTrackCount>(folder);
+    }
+
+    Command<Mp3_Command_GetTotalFolderCount> getTotalFolderCount()
+    {
+        return command<Mp3_Command_GetTotalFolderCount>();
+    }
+
+    Command<Mp3_Command_GetSdTrackCount> getTotalTrackCount(DfMp3_PlaySource source = DfMp3_PlaySource_Sd)
+    {
+        return Command<Mp3_Command_GetSdTrackCount>(_mp3, 0, 
+                Mp3_CommandForSource(Mp3_Commands_GetUsbTrackCount, source));
+    }
+
+    Command<Mp3_Command_GetSdCurrentTrack> getCurrentTrack(DfMp3_PlaySource source = DfMp3_PlaySource_Sd)
+    {
+        return Command<Mp3_Command_GetSdCurrentTrack>(_mp3, 0, 
+                Mp3_CommandForSource(Mp3_Commands_GetUsbCurrentTrack, source));
+    }
+
+private:
+    T_DFMINIMP3& _mp3;
+};
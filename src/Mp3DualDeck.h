@@ -0,0 +1,326 @@
+/*-------------------------------------------------------------------------
+DFMiniMp3 library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// Plays a playlist across two modules whose outputs are mixed,
+// so one track fades into the next without a gap.  The next track
+// is started muted and paused on the idle deck a little before the
+// fade, so it is ready to go, then at crossfadeTime before the end
+// of the playing track the volumes are stepped against each other.
+//
+// The playlist is a callback giving the next clip and its duration,
+// with a zero duration the next track starts when the playing one
+// is reported finished, with a gap.
+//
+// Mp3DualDeck<DfMp3> decks(dfmp3A, dfmp3B, nextClip);
+// decks.start();
+//
+// call decks.loop() from loop() along with both dfmp3.loop(), and
+// decks.onPlayFinished(mp3) from the notification OnPlayFinished;
+// as each command first calls the notifications already read, one
+// arriving during a command of the decks is handled after it
+//
+template <class T_DFMINIMP3> class Mp3DualDeck
+{
+public:
+    // return false when the playlist has ended
+    typedef bool (*NextClip)(DfMp3_Clip* clip, uint32_t* duration, void* context);
+
+    Mp3DualDeck(T_DFMINIMP3& deckA, T_DFMINIMP3& deckB, NextClip nextClip, void* context = nullptr) :
+        _nextClip(nextClip),
+        _context(context),
+        _volume(20),
+        _crossfadeTime(3000),
+        _active(0),
+        _state(State_Idle),
+        _level(0),
+        _started(0),
+        _duration(0),
+        _nextStarted(0),
+        _nextDuration(0),
+        _stepStarted(0),
+        _finished(0),
+        _isBusy(false)
+    {
+        _decks[0] = &deckA;
+        _decks[1] = &deckB;
+    }
+
+    // 0-30, the volume of the playing deck
+    void setVolume(uint8_t volume)
+    {
+        _volume = volume;
+        if (_state == State_Playing || _state == State_Preloaded || _state == State_Last)
+        {
+            _isBusy = true;
+            active().setVolume(_volume);
+            settle();
+        }
+    }
+
+    void setCrossfadeTime(uint16_t crossfadeTime)
+    {
+        _crossfadeTime = crossfadeTime;
+    }
+
+    // plays the first clip of the playlist on deck A
+    bool start()
+    {
+        DfMp3_Clip clip;
+
+        stop();
+        if (!_nextClip(&clip, &_duration, _context))
+        {
+            return false;
+        }
+
+        _isBusy = true;
+        _active = 0;
+        idle().setVolume(0);
+        active().setVolume(_volume);
+        active().playClip(clip);
+        _started = millis();
+        _state = State_Playing;
+        // what finished meanwhile played before
+        _finished = 0;
+        _isBusy = false;
+        return true;
+    }
+
+    void stop()
+    {
+        if (_state != State_Idle)
+        {
+            _isBusy = true;
+            _decks[0]->stop();
+            _decks[1]->stop();
+            _state = State_Idle;
+            _finished = 0;
+            _isBusy = false;
+        }
+    }
+
+    bool isPlaying() const
+    {
+        return (_state != State_Idle);
+    }
+
+    // 0 for deck A, 1 for deck B
+    uint8_t getActiveDeck() const
+    {
+        return _active;
+    }
+
+    void onPlayFinished(T_DFMINIMP3& mp3)
+    {
+        _finished |= (&mp3 == _decks[0]) ? 0x01 : 0x02;
+        if (!_isBusy)
+        {
+            _isBusy = true;
+            settle();
+        }
+    }
+
+    void loop()
+    {
+        uint32_t now = millis();
+
+        _isBusy = true;
+        switch (_state)
+        {
+        case State_Playing:
+            if (_duration &&
+                (now - _started + c_PreloadTime) >= fadeStart() &&
+                !preload())
+            {
+                _state = State_Last;
+            }
+            break;
+
+        case State_Preloaded:
+            if ((now - _started) >= fadeStart())
+            {
+                idle().start();
+                _nextStarted = now;
+                _stepStarted = now;
+                _level = 0;
+                _state = State_Fading;
+            }
+            break;
+
+        case State_Fading:
+            if ((now - _stepStarted) >= stepTime())
+            {
+                _stepStarted += stepTime();
+                _level++;
+                if (_level >= _volume)
+                {
+                    // faded, or setVolume() lowered the volume below
+                    // the level already reached
+                    active().stop();
+                    idle().setVolume(_volume);
+                    swap(_nextStarted);
+                }
+                else
+                {
+                    active().setVolume(_volume - _level);
+                    idle().setVolume(_level);
+                }
+            }
+            break;
+        }
+        settle();
+    }
+
+private:
+    enum State
+    {
+        State_Idle,
+        State_Playing,
+        State_Preloaded, // next clip is paused and muted on the idle deck
+        State_Fading,
+        State_Last // the playlist has ended, playing the last clip
+    };
+
+    // how long before the fade the next clip is readied
+    static const uint16_t c_PreloadTime = 1000;
+
+    T_DFMINIMP3* _decks[2];
+    NextClip _nextClip;
+    void* _context;
+    uint8_t _volume;
+    uint16_t _crossfadeTime;
+    uint8_t _active;
+    uint8_t _state;
+    uint8_t _level; // fade step, the volume of the incoming deck
+    uint32_t _started; // millis() the active clip started
+    uint32_t _duration; // ms of the active clip, zero when unknown
+    uint32_t _nextStarted;
+    uint32_t _nextDuration;
+    uint32_t _stepStarted;
+    uint8_t _finished; // bit per deck reported finished while busy
+    bool _isBusy; // sending commands to the decks
+
+    // handles what finished while busy, then is no longer busy
+    void settle()
+    {
+        while (_finished)
+        {
+            uint8_t finished = _finished;
+
+            _finished = 0;
+            // others are a deck that faded out, or a repeated report
+            if (finished & (1 << _active))
+            {
+                activeFinished();
+            }
+        }
+        _isBusy = false;
+    }
+
+    void activeFinished()
+    {
+        switch (_state)
+        {
+        case State_Playing:
+        {
+            // no duration known, or it was shorter than thought
+            DfMp3_Clip clip;
+
+            if (_nextClip(&clip, &_nextDuration, _context))
+            {
+                idle().setVolume(_volume);
+                idle().playClip(clip);
+                swap(millis());
+            }
+            else
+            {
+                _state = State_Idle;
+            }
+            break;
+        }
+
+        case State_Preloaded:
+            idle().setVolume(_volume);
+            idle().start();
+            swap(millis());
+            break;
+
+        case State_Fading:
+            idle().setVolume(_volume);
+            swap(_nextStarted);
+            break;
+
+        case State_Last:
+            _state = State_Idle;
+            break;
+        }
+    }
+
+    T_DFMINIMP3& active()
+    {
+        return *_decks[_active];
+    }
+
+    T_DFMINIMP3& idle()
+    {
+        return *_decks[_active ^ 1];
+    }
+
+    uint32_t fadeStart() const
+    {
+        return (_duration > _crossfadeTime) ? (_duration - _crossfadeTime) : 0;
+    }
+
+    uint16_t stepTime() const
+    {
+        return _volume ? (_crossfadeTime / _volume) : 0;
+    }
+
+    bool preload()
+    {
+        DfMp3_Clip clip;
+
+        if (!_nextClip(&clip, &_nextDuration, _context))
+        {
+            return false;
+        }
+
+        idle().setVolume(0);
+        idle().playClip(clip);
+        idle().pause();
+        _state = State_Preloaded;
+        return true;
+    }
+
+    void swap(uint32_t started)
+    {
+        _active ^= 1;
+        _started = started;
+        _duration = _nextDuration;
+        _state = State_Playing;
+    }
+};
@@ -0,0 +1,120 @@
+/*-------------------------------------------------------------------------
+DFMiniMp3 library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// Puts the module to sleep, with its dac off, once nothing has been
+// playing or sent for idleTime.  Needs DfMiniMp3PowerManagement, so 
+// the next command sent wakes the module first on its own.  When the
+// sketch knows something is coming, such as a Mp3Sequencer script or
+// an alarm, expectActivity() wakes it ahead by the wake latency 
+// measured so far, so that command is not held up.
+//
+// Mp3IdleManager<DfMp3> idle(dfmp3, 60000);
+//
+// call idle.loop() from loop() along with dfmp3.loop()
+//
+template <class T_DFMINIMP3> class Mp3IdleManager
+{
+public:
+    Mp3IdleManager(T_DFMINIMP3& mp3, uint32_t idleTime = 30000) :
+        _mp3(mp3),
+        _idleTime(idleTime),
+        _wakeAt(0),
+        _busy(0),
+        _isWakeExpected(false)
+    {
+    }
+
+    void setIdleTime(uint32_t idleTime)
+    {
+        _idleTime = idleTime;
+    }
+
+    // a command is expected in ms, keeps the module awake for it
+    void expectActivity(uint32_t in)
+    {
+        uint32_t lead = getWakeLead();
+
+        _wakeAt = millis() + ((in > lead) ? (in - lead) : 0);
+        _isWakeExpected = true;
+    }
+
+    // ms a wake is expected to take, from those measured
+    uint32_t getWakeLead() const
+    {
+        const DfMp3_PowerStats& stats = _mp3.getPowerStats();
+
+        if (stats.wakes == 0)
+        {
+            return c_DefaultWakeLead;
+        }
+        return (stats.wakeLatencyTotal / stats.wakes + 999) / 1000;
+    }
+
+    void loop()
+    {
+        uint32_t now = millis();
+
+        if (_isWakeExpected)
+        {
+            if (static_cast<int32_t>(now - _wakeAt) >= 0)
+            {
+                _isWakeExpected = false;
+                _mp3.wake();
+                _busy = now;
+            }
+            else if (_wakeAt - now <= _idleTime)
+            {
+                // not worth sleeping
+                return;
+            }
+        }
+
+        if (_mp3.isPlaybackExpected())
+        {
+            _busy = now;
+            return;
+        }
+
+        if (!_mp3.isSleeping() &&
+            (now - _busy) >= _idleTime &&
+            (now - _mp3.getLastActivity()) >= _idleTime)
+        {
+            _mp3.disableDac();
+            _mp3.sleep();
+        }
+    }
+
+private:
+    // until a wake has been measured
+    static const uint16_t c_DefaultWakeLead = 100;
+
+    T_DFMINIMP3& _mp3;
+    uint32_t _idleTime;
+    uint32_t _wakeAt; // millis()
+    uint32_t _busy; // millis() last seen playing or woken
+    bool _isWakeExpected;
+};
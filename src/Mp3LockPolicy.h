@@ -0,0 +1,115 @@
+/*-------------------------------------------------------------------------
+DFMiniMp3 library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// Lock policies for the T_LOCK_POLICY template argument of DFMiniMp3,
+// include this only when sharing a module between tasks or threads.
+// The lock is held for a whole transaction and while notifications
+// are called, so it must be recursive; a notification may query the
+// module and that transaction is nested on the same thread.
+//
+// #include <DFMiniMp3.h>
+// #include <Mp3LockPolicy.h>
+// typedef DFMiniMp3<HardwareSerial, Mp3Notify, Mp3ChipOriginal, 900, Mp3LockFreeRtos> DfMp3;
+//
+
+#include "internal/Mp3LockNone.h"
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#define Mp3_LockFreeRtosAvailable
+#elif defined(INC_FREERTOS_H)
+#include <semphr.h>
+#define Mp3_LockFreeRtosAvailable
+#endif
+
+#ifdef Mp3_LockFreeRtosAvailable
+// tasks sharing one module under FreeRTOS
+class Mp3LockFreeRtos
+{
+public:
+    Mp3LockFreeRtos() :
+        _mutex(xSemaphoreCreateRecursiveMutex())
+    {
+    }
+
+    ~Mp3LockFreeRtos()
+    {
+        vSemaphoreDelete(_mutex);
+    }
+
+    void lock()
+    {
+        xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+    }
+
+    void unlock()
+    {
+        xSemaphoreGiveRecursive(_mutex);
+    }
+
+private:
+    SemaphoreHandle_t _mutex;
+
+    Mp3LockFreeRtos(const Mp3LockFreeRtos&);
+    Mp3LockFreeRtos& operator=(const Mp3LockFreeRtos&);
+};
+#endif
+
+// bare metal cores may ship <mutex> without the threads it needs,
+// define DfMiniMp3LockStdMutex to use it where that can't be told
+#if !defined(__AVR__) && defined(__has_include)
+#if __has_include(<mutex>)
+#include <mutex>
+#if defined(_GLIBCXX_HAS_GTHREADS) || \
+    (defined(_LIBCPP_VERSION) && !defined(_LIBCPP_HAS_NO_THREADS)) || \
+    defined(_MSC_VER) || \
+    defined(DfMiniMp3LockStdMutex)
+#define Mp3_LockStdMutexAvailable
+#endif
+#endif
+#endif
+
+#ifdef Mp3_LockStdMutexAvailable
+// threads sharing one module on Linux and other hosted platforms
+class Mp3LockStdMutex
+{
+public:
+    void lock()
+    {
+        _mutex.lock();
+    }
+
+    void unlock()
+    {
+        _mutex.unlock();
+    }
+
+private:
+    std::recursive_mutex _mutex;
+};
+#endif
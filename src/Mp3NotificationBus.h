@@ -0,0 +1,148 @@
+/*-------------------------------------------------------------------------
+Mp3NotificationBus - T_NOTIFICATION_METHOD that fans out to many subscribers
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// Use in place of a notification class when more than one part of a 
+// sketch needs the notifications.  Subscribers are kept in a fixed 
+// table, each with a mask of DfMp3_EventType it wants, so calling them 
+// is only a bit test per subscriber.  A static notification class as 
+// used before works as it always did, this is only used when chosen.
+//
+// class Mp3Bus;
+// typedef DFMiniMp3<HardwareSerial, Mp3Bus> DfMp3;
+// class Mp3Bus : public Mp3NotificationBus<DfMp3, 4> {};
+//
+// Mp3Bus::subscribe(onPlaylistEvent, DfMp3_EventType_PlayFinished);
+// Mp3Bus::subscribe(onUiEvent, DfMp3_EventType_PlaySource | DfMp3_EventType_Error);
+//
+template <class T_DFMINIMP3, uint8_t C_MAX_SUBSCRIBERS = 4> class Mp3NotificationBus
+{
+public:
+    typedef void (*Handler)(T_DFMINIMP3& mp3, const DfMp3_Event& event, void* context);
+
+    // call from setup(), not while notifications are being called
+    static bool subscribe(Handler handler, uint8_t eventMask = DfMp3_EventType_All, void* context = nullptr)
+    {
+        if (s_count >= C_MAX_SUBSCRIBERS)
+        {
+            return false;
+        }
+
+        s_subscribers[s_count].eventMask = eventMask;
+        s_subscribers[s_count].handler = handler;
+        s_subscribers[s_count].context = context;
+        s_count++;
+        return true;
+    }
+
+    static void unsubscribe(Handler handler, void* context = nullptr)
+    {
+        uint8_t index = 0;
+
+        while (index < s_count)
+        {
+            if (s_subscribers[index].handler == handler &&
+                s_subscribers[index].context == context)
+            {
+                // keep the order of the remaining subscribers
+                s_count--;
+                for (uint8_t move = index; move < s_count; move++)
+                {
+                    s_subscribers[move] = s_subscribers[move + 1];
+                }
+            }
+            else
+            {
+                index++;
+            }
+        }
+    }
+
+    static void OnError(T_DFMINIMP3& mp3, uint16_t errorCode)
+    {
+        DfMp3_Event event = { DfMp3_EventType_Error, static_cast<DfMp3_PlaySources>(0), errorCode, 0 };
+        dispatch(mp3, event);
+    }
+
+    static void OnPlayFinished(T_DFMINIMP3& mp3, DfMp3_PlaySources source, uint16_t track)
+    {
+        DfMp3_Event event = { DfMp3_EventType_PlayFinished, source, track, 0 };
+        dispatch(mp3, event);
+    }
+
+    static void OnPlaySourceOnline(T_DFMINIMP3& mp3, DfMp3_PlaySources source)
+    {
+        DfMp3_Event event = { DfMp3_EventType_PlaySourceOnline, source, 0, 0 };
+        dispatch(mp3, event);
+    }
+
+    static void OnPlaySourceInserted(T_DFMINIMP3& mp3, DfMp3_PlaySources source)
+    {
+        DfMp3_Event event = { DfMp3_EventType_PlaySourceInserted, source, 0, 0 };
+        dispatch(mp3, event);
+    }
+
+    static void OnPlaySourceRemoved(T_DFMINIMP3& mp3, DfMp3_PlaySources source)
+    {
+        DfMp3_Event event = { DfMp3_EventType_PlaySourceRemoved, source, 0, 0 };
+        dispatch(mp3, event);
+    }
+
+private:
+    struct subscriber_t
+    {
+        uint8_t eventMask;
+        Handler handler;
+        void* context;
+    };
+
+    static subscriber_t s_subscribers[C_MAX_SUBSCRIBERS];
+    static uint8_t s_count;
+
+    static void dispatch(T_DFMINIMP3& mp3, DfMp3_Event& event)
+    {
+#ifdef DfMiniMp3Stats
+        event.received = mp3.getNotificationReceived();
+#endif
+        const subscriber_t* subscriber = s_subscribers;
+        const subscriber_t* end = s_subscribers + s_count;
+
+        for (; subscriber < end; subscriber++)
+        {
+            if (subscriber->eventMask & event.type)
+            {
+                subscriber->handler(mp3, event, subscriber->context);
+            }
+        }
+    }
+};
+
+template <class T_DFMINIMP3, uint8_t C_MAX_SUBSCRIBERS>
+typename Mp3NotificationBus<T_DFMINIMP3, C_MAX_SUBSCRIBERS>::subscriber_t 
+    Mp3NotificationBus<T_DFMINIMP3, C_MAX_SUBSCRIBERS>::s_subscribers[C_MAX_SUBSCRIBERS];
+
+template <class T_DFMINIMP3, uint8_t C_MAX_SUBSCRIBERS>
+uint8_t Mp3NotificationBus<T_DFMINIMP3, C_MAX_SUBSCRIBERS>::s_count = 0;
@@ -0,0 +1,249 @@
+/*-------------------------------------------------------------------------
+DFMiniMp3 library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// Finds modules that stopped playing without reporting the track
+// finished and gets them playing again.  The status is only queried
+// while DFMiniMp3 expects playback, starting at minInterval after a
+// play command and doubling up to maxInterval while all is well.
+// A stop found in a status reply is confirmed once, a query without
+// a reply is not taken as one, then recovery steps up from
+// start(), to sending the last play command again, to a reset()
+// followed by the last play command.
+//
+// Mp3PlaybackWatchdog<DfMp3> watchdog(dfmp3);
+//
+// call watchdog.loop() from loop() along with dfmp3.loop()
+//
+template <class T_DFMINIMP3> class Mp3PlaybackWatchdog
+{
+public:
+    Mp3PlaybackWatchdog(T_DFMINIMP3& mp3, uint16_t minInterval = 1000, uint16_t maxInterval = 8000) :
+        _mp3(mp3),
+        _minInterval(minInterval),
+        _maxInterval(maxInterval),
+        _interval(minInterval),
+        _step(Step_Watching),
+        _commanded(0),
+        _waitStarted(0),
+        _wait(0),
+        _stalled(0),
+        _stats()
+    {
+    }
+
+    void loop()
+    {
+        uint32_t now = millis();
+
+        if (_step != Step_Resetting && !_mp3.isPlaybackExpected())
+        {
+            // idle, or the sketch stopped playback while recovering
+            _step = Step_Watching;
+            _interval = _minInterval;
+            return;
+        }
+
+        if (_step == Step_Watching && _mp3.getPlaybackCommanded() != _commanded)
+        {
+            // newly started, give it time to get going
+            _commanded = _mp3.getPlaybackCommanded();
+            _interval = _minInterval;
+            wait(_commanded, _interval);
+        }
+
+        if (now - _waitStarted < _wait)
+        {
+            return;
+        }
+
+        if (_step == Step_Resetting)
+        {
+            if (!_mp3.isOnline() && now - _waitStarted < c_ResetTimeout)
+            {
+                return;
+            }
+            _mp3.replayLastPlay();
+            next(Step_ReplayedAfterReset, now, _minInterval);
+            return;
+        }
+
+        poll(now);
+    }
+
+    const DfMp3_WatchdogStats& getStats() const
+    {
+        return _stats;
+    }
+
+    void resetStats()
+    {
+        _stats = {};
+    }
+
+private:
+    enum Step
+    {
+        Step_Watching,
+        Step_Confirming,
+        Step_Started,
+        Step_Replayed,
+        Step_Resetting,
+        Step_ReplayedAfterReset
+    };
+
+    // a track finishing as it is polled can look like a stall
+    static const uint16_t c_ConfirmInterval = 250;
+    static const uint16_t c_ResetTimeout = 5000;
+
+    T_DFMINIMP3& _mp3;
+    uint16_t _minInterval;
+    uint16_t _maxInterval;
+    uint16_t _interval; // between polls while playing
+    uint8_t _step;
+    uint32_t _commanded; // getPlaybackCommanded() last seen
+    uint32_t _waitStarted;
+    uint16_t _wait;
+    uint32_t _stalled; // millis() the stall was confirmed
+    DfMp3_WatchdogStats _stats;
+
+    void wait(uint32_t now, uint16_t time)
+    {
+        _waitStarted = now;
+        _wait = time;
+    }
+
+    void next(Step step, uint32_t now, uint16_t time)
+    {
+        if (step == Step_Watching)
+        {
+            // our own recovery commands are not a new start
+            _commanded = _mp3.getPlaybackCommanded();
+        }
+        _step = step;
+        wait(now, time);
+    }
+
+    void recovered(uint16_t* counter, uint32_t now)
+    {
+        uint32_t time = now - _stalled;
+
+        (*counter)++;
+        _stats.recoveryTimeTotal += time;
+        if (time > _stats.recoveryTimeMax)
+        {
+            _stats.recoveryTimeMax = time;
+        }
+
+        _interval = _minInterval;
+        next(Step_Watching, now, _interval);
+    }
+
+    void poll(uint32_t now)
+    {
+        DfMp3_Status status;
+
+        _stats.polls++;
+        if (!_mp3.template tryQuery<Mp3_Command_GetStatus>(&status))
+        {
+            // a lost reply says nothing about playback, ask again 
+            // without taking a recovery step, once its retries are over
+            _stats.pollFailures++;
+            wait(millis(), _minInterval);
+            return;
+        }
+
+        // shuffling also has the playing bit set
+        bool isPlaybackFound = (status.state & DfMp3_StatusState_Playing);
+
+        switch (_step)
+        {
+        case Step_Watching:
+            if (isPlaybackFound)
+            {
+                _interval = (_interval < _maxInterval / 2) ? _interval * 2 : _maxInterval;
+                wait(now, _interval);
+            }
+            else
+            {
+                next(Step_Confirming, now, c_ConfirmInterval);
+            }
+            break;
+
+        case Step_Confirming:
+            if (isPlaybackFound)
+            {
+                next(Step_Watching, now, _interval);
+            }
+            else
+            {
+                _stats.stalls++;
+                _stalled = now;
+                _mp3.start();
+                next(Step_Started, now, _minInterval);
+            }
+            break;
+
+        case Step_Started:
+            if (isPlaybackFound)
+            {
+                recovered(&_stats.recoveredByStart, now);
+            }
+            else
+            {
+                _mp3.replayLastPlay();
+                next(Step_Replayed, now, _minInterval);
+            }
+            break;
+
+        case Step_Replayed:
+            if (isPlaybackFound)
+            {
+                recovered(&_stats.recoveredByReplay, now);
+            }
+            else
+            {
+                _mp3.reset(false);
+                next(Step_Resetting, now, 0);
+            }
+            break;
+
+        case Step_ReplayedAfterReset:
+            if (isPlaybackFound)
+            {
+                recovered(&_stats.recoveredByReset, now);
+            }
+            else
+            {
+                // try again later, but not often
+                _stats.unrecovered++;
+                _interval = _maxInterval;
+                next(Step_Watching, now, _interval);
+            }
+            break;
+        }
+    }
+};
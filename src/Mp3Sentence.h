@@ -0,0 +1,200 @@
+/*-------------------------------------------------------------------------
+DFMiniMp3 library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// Builds spoken sentences out of sd:/mp3/#### clips and plays them
+// with DFMiniMp3::playClipChain(), so DfMiniMp3ClipChain must be
+// defined to play them.
+//
+// Mp3Sentence<> sentence;
+// sentence.addFixed(235, 1); // twenty three point five
+// sentence.add(MyClips::Degrees);
+// sentence.play(dfmp3);
+//
+
+// where the spoken words are in sd:/mp3/####, provide a class with
+// the same members to T_CLIPS for recordings laid out differently
+class Mp3SpokenClips
+{
+public:
+    static const uint16_t Numbers = 1; // zero to nineteen, 0001 to 0020
+    static const uint16_t Tens = 21; // twenty to ninety, 0021 to 0028
+    static const uint16_t Hundred = 29;
+    static const uint16_t Thousand = 30;
+    static const uint16_t Point = 31;
+    static const uint16_t Minus = 32;
+};
+
+// a sentence holds as many clips as the chain plays, the first and
+// the ones staged after it
+#ifdef DfMiniMp3ClipChain
+#define Mp3_SentenceMaxClips (DfMiniMp3ClipChain + 1)
+#else
+#define Mp3_SentenceMaxClips 16
+#endif
+
+template <class T_CLIPS = Mp3SpokenClips, uint8_t C_MAX_CLIPS = Mp3_SentenceMaxClips> class Mp3Sentence
+{
+public:
+    Mp3Sentence() :
+        _count(0)
+    {
+    }
+
+    // the clip of a number below one hundred that has one,
+    // so "twenty" but not "twenty one"
+    static constexpr uint16_t clipForNumber(uint8_t number)
+    {
+        return (number < 20) ?
+            (T_CLIPS::Numbers + number) :
+            (T_CLIPS::Tens + (number / 10) - 2);
+    }
+
+    void clear()
+    {
+        _count = 0;
+    }
+
+    // any other clip, a word or a sound
+    bool add(uint16_t clip)
+    {
+        if (_count >= C_MAX_CLIPS)
+        {
+            return false;
+        }
+        _clips[_count++] = clip;
+        return true;
+    }
+
+    // whole numbers up to 999999 either way
+    bool addNumber(int32_t number)
+    {
+        bool isAdded = true;
+
+        if (number < 0)
+        {
+            isAdded = add(T_CLIPS::Minus);
+            number = -number;
+        }
+        return isAdded && addWhole(static_cast<uint32_t>(number));
+    }
+
+    // value with its last decimals digits after the point,
+    // each spoken as a digit, (235, 1) is "twenty three point five"
+    bool addFixed(int32_t value, uint8_t decimals)
+    {
+        uint32_t scale = 1;
+        bool isAdded = true;
+
+        for (uint8_t digit = 0; digit < decimals; digit++)
+        {
+            scale *= 10;
+        }
+
+        if (value < 0)
+        {
+            isAdded = add(T_CLIPS::Minus);
+            value = -value;
+        }
+
+        uint32_t whole = static_cast<uint32_t>(value) / scale;
+        uint32_t fraction = static_cast<uint32_t>(value) % scale;
+
+        isAdded = isAdded && addWhole(whole);
+        if (decimals)
+        {
+            isAdded = isAdded && add(T_CLIPS::Point);
+            while (isAdded && scale > 1)
+            {
+                scale /= 10;
+                isAdded = add(clipForNumber(fraction / scale));
+                fraction %= scale;
+            }
+        }
+        return isAdded;
+    }
+
+    uint8_t getCount() const
+    {
+        return _count;
+    }
+
+    const uint16_t* getClips() const
+    {
+        return _clips;
+    }
+
+    template <class T_DFMINIMP3> bool play(T_DFMINIMP3& mp3) const
+    {
+#ifdef DfMiniMp3ClipChain
+        static_assert(C_MAX_CLIPS <= DfMiniMp3ClipChain + 1, 
+            "C_MAX_CLIPS is more than DfMiniMp3ClipChain plays");
+        return mp3.playClipChain(_clips, _count);
+#else
+        static_assert(sizeof(T_DFMINIMP3) == 0, "sentences play through DfMiniMp3ClipChain");
+        return false;
+#endif
+    }
+
+private:
+    uint16_t _clips[C_MAX_CLIPS];
+    uint8_t _count;
+
+    bool addWhole(uint32_t number)
+    {
+        if (number == 0)
+        {
+            return add(clipForNumber(0));
+        }
+        return addNonZero(number);
+    }
+
+    bool addNonZero(uint32_t number)
+    {
+        bool isAdded = true;
+
+        if (number >= 1000)
+        {
+            isAdded = addNonZero(number / 1000) && add(T_CLIPS::Thousand);
+            number %= 1000;
+        }
+        if (isAdded && number >= 100)
+        {
+            isAdded = add(clipForNumber(number / 100)) && add(T_CLIPS::Hundred);
+            number %= 100;
+        }
+        if (isAdded && number >= 20)
+        {
+            isAdded = add(clipForNumber(number));
+            number %= 10;
+        }
+        if (isAdded && number > 0)
+        {
+            isAdded = add(clipForNumber(number));
+        }
+        return isAdded;
+    }
+};
@@ -0,0 +1,367 @@
+/*-------------------------------------------------------------------------
+DFMiniMp3 library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// Runs scripted sequences of commands without blocking loop().
+// A script is a byte array built from the Mp3Seq_ macros and kept
+// in flash, only the position and timing of each running sequence
+// is kept in RAM.
+//
+// static const uint8_t c_show[] Mp3_ProgMem =
+// {
+//     Mp3Seq_Volume(10),
+//     Mp3Seq_PlayFolderTrack(3, 12),
+//     Mp3Seq_Wait(4500),
+//     Mp3Seq_PlayAdvertisement(7),
+//     Mp3Seq_WaitFinished(),
+//     Mp3Seq_Fade(0, 2000),
+//     Mp3Seq_Sleep(),
+//     Mp3Seq_End()
+// };
+//
+// Mp3Sequencer<DfMp3, 2> sequencer;
+// sequencer.start(dfmp3, c_show);
+//
+// call sequencer.loop() from loop() along with dfmp3.loop(), and
+// sequencer.onPlayFinished(mp3) from the notification OnPlayFinished
+//
+
+enum Mp3_SequenceOp
+{
+    Mp3_SequenceOp_End,                 //
+    Mp3_SequenceOp_Volume,              // volume
+    Mp3_SequenceOp_PlayGlobalTrack,     // track high, low
+    Mp3_SequenceOp_PlayMp3FolderTrack,  // track high, low
+    Mp3_SequenceOp_PlayFolderTrack,     // folder, track
+    Mp3_SequenceOp_PlayFolderTrack16,   // folder, track high, low
+    Mp3_SequenceOp_PlayAdvertisement,   // track high, low
+    Mp3_SequenceOp_Wait,                // ms high, low
+    Mp3_SequenceOp_WaitFinished,        //
+    Mp3_SequenceOp_Fade,                // volume, ms high, low
+    Mp3_SequenceOp_Pause,               //
+    Mp3_SequenceOp_Start,               //
+    Mp3_SequenceOp_Stop,                //
+    Mp3_SequenceOp_Sleep,               //
+    Mp3_SequenceOp_Repeat               //
+};
+
+#define Mp3Seq_High(value) static_cast<uint8_t>((value) >> 8)
+#define Mp3Seq_Low(value) static_cast<uint8_t>((value) & 0xff)
+
+#define Mp3Seq_End() Mp3_SequenceOp_End
+#define Mp3Seq_Volume(volume) Mp3_SequenceOp_Volume, static_cast<uint8_t>(volume)
+#define Mp3Seq_PlayGlobalTrack(track) Mp3_SequenceOp_PlayGlobalTrack, Mp3Seq_High(track), Mp3Seq_Low(track)
+#define Mp3Seq_PlayMp3FolderTrack(track) Mp3_SequenceOp_PlayMp3FolderTrack, Mp3Seq_High(track), Mp3Seq_Low(track)
+#define Mp3Seq_PlayFolderTrack(folder, track) Mp3_SequenceOp_PlayFolderTrack, static_cast<uint8_t>(folder), static_cast<uint8_t>(track)
+#define Mp3Seq_PlayFolderTrack16(folder, track) Mp3_SequenceOp_PlayFolderTrack16, static_cast<uint8_t>(folder), Mp3Seq_High(track), Mp3Seq_Low(track)
+#define Mp3Seq_PlayAdvertisement(track) Mp3_SequenceOp_PlayAdvertisement, Mp3Seq_High(track), Mp3Seq_Low(track)
+// up to 65535ms, use more than one for longer
+#define Mp3Seq_Wait(ms) Mp3_SequenceOp_Wait, Mp3Seq_High(ms), Mp3Seq_Low(ms)
+// until OnPlayFinished since the last play step
+#define Mp3Seq_WaitFinished() Mp3_SequenceOp_WaitFinished
+// steps the volume one at a time to reach volume after ms
+#define Mp3Seq_Fade(volume, ms) Mp3_SequenceOp_Fade, static_cast<uint8_t>(volume), Mp3Seq_High(ms), Mp3Seq_Low(ms)
+#define Mp3Seq_Pause() Mp3_SequenceOp_Pause
+#define Mp3Seq_Start() Mp3_SequenceOp_Start
+#define Mp3Seq_Stop() Mp3_SequenceOp_Stop
+#define Mp3Seq_Sleep() Mp3_SequenceOp_Sleep
+// back to the first step
+#define Mp3Seq_Repeat() Mp3_SequenceOp_Repeat
+
+template <class T_DFMINIMP3, uint8_t C_MAX_SEQUENCES = 2> class Mp3Sequencer
+{
+public:
+    Mp3Sequencer()
+    {
+        for (uint8_t index = 0; index < C_MAX_SEQUENCES; index++)
+        {
+            _sequences[index].script = nullptr;
+        }
+    }
+
+    // returns the handle of the sequence, or -1 when all are in use
+    int8_t start(T_DFMINIMP3& mp3, const uint8_t* script)
+    {
+        for (uint8_t index = 0; index < C_MAX_SEQUENCES; index++)
+        {
+            sequence_t& sequence = _sequences[index];
+
+            if (sequence.script == nullptr)
+            {
+                sequence.script = script;
+                sequence.mp3 = &mp3;
+                sequence.step = 0;
+                sequence.state = State_Running;
+                sequence.finished = false;
+                sequence.volume = c_VolumeUnknown;
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    // the module is left as it is, only the script stops
+    void stop(int8_t handle)
+    {
+        if (isValid(handle))
+        {
+            _sequences[handle].script = nullptr;
+        }
+    }
+
+    bool isRunning(int8_t handle) const
+    {
+        return (isValid(handle) && _sequences[handle].script != nullptr);
+    }
+
+    void onPlayFinished(T_DFMINIMP3& mp3)
+    {
+        for (uint8_t index = 0; index < C_MAX_SEQUENCES; index++)
+        {
+            if (_sequences[index].mp3 == &mp3)
+            {
+                _sequences[index].finished = true;
+            }
+        }
+    }
+
+    void loop()
+    {
+        uint32_t now = millis();
+
+        for (uint8_t index = 0; index < C_MAX_SEQUENCES; index++)
+        {
+            sequence_t& sequence = _sequences[index];
+
+            if (sequence.script != nullptr && isReady(sequence, now))
+            {
+                run(sequence, now);
+            }
+        }
+    }
+
+private:
+    enum State
+    {
+        State_Running,
+        State_Waiting,
+        State_WaitingFinished,
+        State_Fading
+    };
+
+    struct sequence_t
+    {
+        const uint8_t* script; // nullptr when not in use
+        T_DFMINIMP3* mp3;
+        uint16_t step; // offset of the next op in script
+        uint32_t waitStarted;
+        uint16_t waitTime;
+        uint8_t state;
+        bool finished; // OnPlayFinished since the last play step
+        uint8_t volume; // last volume set
+        uint8_t fadeVolume;
+    };
+
+    static const uint8_t c_VolumeUnknown = 0xff;
+    // a repeated script without a wait would never return
+    static const uint8_t c_MaxStepsPerLoop = 8;
+
+    sequence_t _sequences[C_MAX_SEQUENCES];
+
+    static bool isValid(int8_t handle)
+    {
+        return (handle >= 0 && handle < C_MAX_SEQUENCES);
+    }
+
+    static uint8_t readByte(sequence_t& sequence)
+    {
+        return Mp3_ProgMemReadByte(sequence.script + sequence.step++);
+    }
+
+    static uint16_t readWord(sequence_t& sequence)
+    {
+        uint16_t word = static_cast<uint16_t>(readByte(sequence)) << 8;
+        return word | readByte(sequence);
+    }
+
+    static void wait(sequence_t& sequence, uint32_t now, uint16_t time, State state)
+    {
+        sequence.waitStarted = now;
+        sequence.waitTime = time;
+        sequence.state = state;
+    }
+
+    static void play(sequence_t& sequence)
+    {
+        sequence.finished = false;
+    }
+
+    bool isReady(sequence_t& sequence, uint32_t now)
+    {
+        switch (sequence.state)
+        {
+        case State_Waiting:
+            if (now - sequence.waitStarted < sequence.waitTime)
+            {
+                return false;
+            }
+            break;
+
+        case State_WaitingFinished:
+            if (!sequence.finished)
+            {
+                return false;
+            }
+            break;
+
+        case State_Fading:
+            if (now - sequence.waitStarted < sequence.waitTime)
+            {
+                return false;
+            }
+
+            sequence.volume += (sequence.volume < sequence.fadeVolume) ? 1 : -1;
+            sequence.mp3->setVolume(sequence.volume);
+            if (sequence.volume != sequence.fadeVolume)
+            {
+                sequence.waitStarted += sequence.waitTime;
+                return false;
+            }
+            break;
+        }
+
+        sequence.state = State_Running;
+        return true;
+    }
+
+    void run(sequence_t& sequence, uint32_t now)
+    {
+        T_DFMINIMP3& mp3 = *sequence.mp3;
+        uint8_t steps = c_MaxStepsPerLoop;
+
+        while (steps-- && sequence.state == State_Running)
+        {
+            uint8_t op = readByte(sequence);
+
+            switch (op)
+            {
+            case Mp3_SequenceOp_Volume:
+                sequence.volume = readByte(sequence);
+                mp3.setVolume(sequence.volume);
+                break;
+
+            case Mp3_SequenceOp_PlayGlobalTrack:
+                play(sequence);
+                mp3.playGlobalTrack(readWord(sequence));
+                break;
+
+            case Mp3_SequenceOp_PlayMp3FolderTrack:
+                play(sequence);
+                mp3.playMp3FolderTrack(readWord(sequence));
+                break;
+
+            case Mp3_SequenceOp_PlayFolderTrack:
+            {
+                uint8_t folder = readByte(sequence);
+
+                play(sequence);
+                mp3.playFolderTrack(folder, readByte(sequence));
+                break;
+            }
+
+            case Mp3_SequenceOp_PlayFolderTrack16:
+            {
+                uint8_t folder = readByte(sequence);
+
+                play(sequence);
+                mp3.playFolderTrack16(folder, readWord(sequence));
+                break;
+            }
+
+            case Mp3_SequenceOp_PlayAdvertisement:
+                // the interrupted track continues after, it is still
+                // what OnPlayFinished will be waited on for
+                mp3.playAdvertisement(readWord(sequence));
+                break;
+
+            case Mp3_SequenceOp_Wait:
+                wait(sequence, now, readWord(sequence), State_Waiting);
+                break;
+
+            case Mp3_SequenceOp_WaitFinished:
+                if (!sequence.finished)
+                {
+                    sequence.state = State_WaitingFinished;
+                }
+                break;
+
+            case Mp3_SequenceOp_Fade:
+            {
+                sequence.fadeVolume = readByte(sequence);
+                uint16_t time = readWord(sequence);
+
+                if (sequence.volume == c_VolumeUnknown)
+                {
+                    sequence.volume = mp3.getVolume();
+                }
+                if (sequence.volume != sequence.fadeVolume)
+                {
+                    uint8_t distance = (sequence.volume > sequence.fadeVolume) ?
+                        sequence.volume - sequence.fadeVolume :
+                        sequence.fadeVolume - sequence.volume;
+
+                    wait(sequence, now, time / distance, State_Fading);
+                }
+                break;
+            }
+
+            case Mp3_SequenceOp_Pause:
+                mp3.pause();
+                break;
+
+            case Mp3_SequenceOp_Start:
+                mp3.start();
+                break;
+
+            case Mp3_SequenceOp_Stop:
+                mp3.stop();
+                break;
+
+            case Mp3_SequenceOp_Sleep:
+                mp3.sleep();
+                break;
+
+            case Mp3_SequenceOp_Repeat:
+                sequence.step = 0;
+                break;
+
+            default: // Mp3_SequenceOp_End and anything unknown
+                sequence.script = nullptr;
+                return;
+            }
+        }
+    }
+};
@@ -0,0 +1,269 @@
+/*-------------------------------------------------------------------------
+Mp3TraceReplaySerial - T_SERIAL_METHOD that replays a DfMiniMp3Trace capture
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+#include "DfMp3Types.h"
+
+// Plays the part of the module using records captured by dumpTrace().
+// Received (In) records become readable only once every Out record
+// before them has been written, so the original ordering of the session
+// is reproduced regardless of how fast the host runs.
+// Written packets are compared against the captured Out records and
+// any difference is counted as a mismatch, the first one's record
+// index is kept.  A write that is not the next Out record resyncs at
+// the first later one it matches, or else stands in for the next, so
+// one divergence does not throw off the rest of the replay.
+//
+// The captured timing is kept too, an In record is readable only once 
+// as much time has passed since the Out record before it was written
+// as did in the capture, and readBytes() waits for it up to the
+// timeout, so slow replies and timeouts happen again as they did.
+// setTimed(false) replays as fast as the host runs, for benchmarks.
+// Timed replay needs millis() and micros() to advance across yield().
+//
+// typedef DFMiniMp3<Mp3TraceReplaySerial, Mp3Notify> DfMp3;
+// Mp3TraceReplaySerial replay(records, recordCount);
+// DfMp3 mp3(replay);
+//
+class Mp3TraceReplaySerial
+{
+public:
+    Mp3TraceReplaySerial(const DfMp3_TraceRecord* records, size_t recordCount) :
+        _records(records),
+        _recordCount(recordCount),
+        _current(0),
+        _offset(0),
+        _mismatches(0),
+        _firstMismatch(0),
+        _timeout(1000),
+        _isTimed(true),
+        _isAnchored(false),
+        _anchorRecorded(0),
+        _anchorReplayed(0)
+    {
+    }
+
+    void begin([[maybe_unused]] unsigned long baud)
+    {
+    }
+
+    void begin([[maybe_unused]] unsigned long baud,
+            [[maybe_unused]] uint32_t config,
+            [[maybe_unused]] int8_t rxPin,
+            [[maybe_unused]] int8_t txPin)
+    {
+    }
+
+    void setTimeout(unsigned long timeout)
+    {
+        _timeout = timeout;
+    }
+
+    void setTimed(bool isTimed)
+    {
+        _isTimed = isTimed;
+    }
+
+    int available()
+    {
+        int count = 0;
+
+        for (size_t index = _current; isReadable(index); index++)
+        {
+            count += _records[index].length;
+        }
+        return count - _offset;
+    }
+
+    size_t readBytes(uint8_t* buffer, size_t length)
+    {
+        size_t read = 0;
+        uint32_t start = millis();
+
+        while (read < length)
+        {
+            if (!isReadable(_current))
+            {
+                // not yet, or nothing was read here in the capture, 
+                // waits out the timeout as the module's serial did
+                if (!_isTimed || (millis() - start) >= _timeout)
+                {
+                    break;
+                }
+                yield();
+                continue;
+            }
+
+            const DfMp3_TraceRecord& record = _records[_current];
+
+            if (_offset < record.length)
+            {
+                buffer[read] = record.data[_offset];
+                read++;
+                _offset++;
+            }
+            if (_offset >= record.length)
+            {
+                _current++;
+                _offset = 0;
+            }
+        }
+        return read;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t next = nextOut(_current);
+        size_t index = next;
+
+        // resync at the Out record it matches, the records passed
+        // over were not replayed
+        while (index < _recordCount && !isMatch(_records[index], buffer, size))
+        {
+            index = nextOut(index + 1);
+        }
+        if (index >= _recordCount)
+        {
+            // sent something else, it stands in for the next one
+            index = next;
+        }
+
+        if (index != _current || index >= _recordCount ||
+                !isMatch(_records[index], buffer, size))
+        {
+            noteMismatch(_current);
+        }
+        if (index < _recordCount)
+        {
+            anchor(_records[index].timestamp);
+            _current = index + 1;
+            _offset = 0;
+        }
+        return size;
+    }
+
+    // true once all records have been consumed
+    bool isComplete() const
+    {
+        return (_current >= _recordCount);
+    }
+
+    size_t getPosition() const
+    {
+        return _current;
+    }
+
+    size_t getMismatches() const
+    {
+        return _mismatches;
+    }
+
+    // the record where the replay first differed from the capture,
+    // false while it has not
+    bool getFirstMismatch(size_t* index) const
+    {
+        if (_mismatches == 0)
+        {
+            return false;
+        }
+        *index = _firstMismatch;
+        return true;
+    }
+
+    // start the session over from the first record
+    void rewind()
+    {
+        _current = 0;
+        _offset = 0;
+        _mismatches = 0;
+        _firstMismatch = 0;
+        _isAnchored = false;
+    }
+
+private:
+    const DfMp3_TraceRecord* _records;
+    size_t _recordCount;
+    size_t _current;
+    uint8_t _offset;
+    size_t _mismatches;
+    size_t _firstMismatch;
+    unsigned long _timeout;
+    bool _isTimed;
+    bool _isAnchored;
+    uint32_t _anchorRecorded; // micros() in the capture of the last Out
+    uint32_t _anchorReplayed; // micros() it was replayed
+
+    size_t nextOut(size_t index) const
+    {
+        while (index < _recordCount &&
+                _records[index].direction != DfMp3_TraceDirection_Out)
+        {
+            index++;
+        }
+        return index;
+    }
+
+    static bool isMatch(const DfMp3_TraceRecord& record, const uint8_t* buffer, size_t size)
+    {
+        return (record.direction == DfMp3_TraceDirection_Out &&
+                record.length == size &&
+                memcmp(record.data, buffer, size) == 0);
+    }
+
+    void noteMismatch(size_t index)
+    {
+        if (_mismatches == 0)
+        {
+            _firstMismatch = index;
+        }
+        _mismatches++;
+    }
+
+    void anchor(uint32_t recorded)
+    {
+        _anchorRecorded = recorded;
+        _anchorReplayed = micros();
+        _isAnchored = true;
+    }
+
+    bool isReadable(size_t index)
+    {
+        if (index >= _recordCount || _records[index].direction != DfMp3_TraceDirection_In)
+        {
+            return false;
+        }
+        if (!_isTimed)
+        {
+            return true;
+        }
+        if (!_isAnchored)
+        {
+            // the session starts with the first look at it
+            anchor(_records[0].timestamp);
+        }
+        return (micros() - _anchorReplayed) >= (_records[index].timestamp - _anchorRecorded);
+    }
+};
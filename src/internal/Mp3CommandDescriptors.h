@@ -0,0 +1,134 @@
+/*-------------------------------------------------------------------------
+Mp3CommandDescriptors - compile time table of commands and their replies
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+enum Mp3_CommandFlags
+{
+    Mp3_CommandFlags_None = 0x00,
+    Mp3_CommandFlags_Query = 0x01, // replies with the same command and a value
+    Mp3_CommandFlags_NoAck = 0x02, // never acked, sent without waiting
+    Mp3_CommandFlags_Cacheable = 0x04, // reply only changes by our own commands
+};
+
+// converts the reply argument to the type returned to the caller
+template <class T_RESULT> struct Mp3_ReplyDecoder
+{
+    static constexpr T_RESULT decode(uint16_t arg)
+    {
+        return static_cast<T_RESULT>(arg);
+    }
+};
+
+template <> struct Mp3_ReplyDecoder<DfMp3_Status>
+{
+    static constexpr DfMp3_Status decode(uint16_t arg)
+    {
+        return { static_cast<DfMp3_StatusSource>(arg >> 8), 
+            static_cast<DfMp3_StatusState>(arg & 0xff) };
+    }
+};
+
+template <uint8_t C_COMMAND, class T_RESULT, uint8_t C_FLAGS> struct Mp3_CommandDescriptor
+{
+    typedef T_RESULT Result;
+
+    static const uint8_t Command = C_COMMAND;
+    static const uint8_t Flags = C_FLAGS;
+    static const bool IsQuery = !!(C_FLAGS & Mp3_CommandFlags_Query);
+    static const bool IsCacheable = !!(C_FLAGS & Mp3_CommandFlags_Cacheable);
+    static const bool IsNoAck = !!(C_FLAGS & Mp3_CommandFlags_NoAck);
+
+    static constexpr Result decode(uint16_t arg)
+    {
+        return Mp3_ReplyDecoder<T_RESULT>::decode(arg);
+    }
+};
+
+// for DFMiniMp3::send<>()
+template <uint8_t C_COMMAND, uint8_t C_FLAGS = Mp3_CommandFlags_None> struct Mp3_ActionDescriptor :
+    public Mp3_CommandDescriptor<C_COMMAND, uint16_t, C_FLAGS>
+{
+};
+
+// for DFMiniMp3::query<>()
+template <uint8_t C_COMMAND, class T_RESULT = uint16_t, uint8_t C_FLAGS = Mp3_CommandFlags_None> struct Mp3_QueryDescriptor :
+    public Mp3_CommandDescriptor<C_COMMAND, T_RESULT, C_FLAGS | Mp3_CommandFlags_Query>
+{
+};
+
+// the usb, sd and flash variants of a command are in that order,
+// anything but usb and flash is treated as sd
+constexpr uint8_t Mp3_CommandForSource(uint8_t usbCommand, DfMp3_PlaySource source)
+{
+    return usbCommand + 
+        ((source == DfMp3_PlaySource_Usb) ? 0 : 
+        ((source == DfMp3_PlaySource_Flash) ? 2 : 1));
+}
+
+typedef Mp3_ActionDescriptor<Mp3_Commands_PlayNextTrack> Mp3_Command_PlayNextTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_PlayPrevTrack> Mp3_Command_PlayPrevTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_PlayGlobalTrack> Mp3_Command_PlayGlobalTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_IncVolume> Mp3_Command_IncVolume;
+typedef Mp3_ActionDescriptor<Mp3_Commands_DecVolume> Mp3_Command_DecVolume;
+typedef Mp3_ActionDescriptor<Mp3_Commands_SetVolume> Mp3_Command_SetVolume;
+typedef Mp3_ActionDescriptor<Mp3_Commands_SetEq> Mp3_Command_SetEq;
+typedef Mp3_ActionDescriptor<Mp3_Commands_LoopGlobalTrack> Mp3_Command_LoopGlobalTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_SetPlaybackMode> Mp3_Command_SetPlaybackMode;
+typedef Mp3_ActionDescriptor<Mp3_Commands_SetPlaybackSource> Mp3_Command_SetPlaybackSource;
+typedef Mp3_ActionDescriptor<Mp3_Commands_Sleep> Mp3_Command_Sleep;
+typedef Mp3_ActionDescriptor<Mp3_Commands_Awake> Mp3_Command_Awake;
+typedef Mp3_ActionDescriptor<Mp3_Commands_Reset> Mp3_Command_Reset;
+typedef Mp3_ActionDescriptor<Mp3_Commands_Start> Mp3_Command_Start;
+typedef Mp3_ActionDescriptor<Mp3_Commands_Pause> Mp3_Command_Pause;
+typedef Mp3_ActionDescriptor<Mp3_Commands_PlayFolderTrack> Mp3_Command_PlayFolderTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_SetVolumeMute> Mp3_Command_SetVolumeMute;
+typedef Mp3_ActionDescriptor<Mp3_Commands_RepeatPlayInRoot> Mp3_Command_RepeatPlayInRoot;
+typedef Mp3_ActionDescriptor<Mp3_Commands_PlayMp3FolderTrack> Mp3_Command_PlayMp3FolderTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_PlayAdvertTrack> Mp3_Command_PlayAdvertTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_PlayFolderTrack16> Mp3_Command_PlayFolderTrack16;
+typedef Mp3_ActionDescriptor<Mp3_Commands_StopAdvert> Mp3_Command_StopAdvert;
+typedef Mp3_ActionDescriptor<Mp3_Commands_Stop> Mp3_Command_Stop;
+typedef Mp3_ActionDescriptor<Mp3_Commands_LoopInFolder> Mp3_Command_LoopInFolder;
+typedef Mp3_ActionDescriptor<Mp3_Commands_PlayRandmomGlobalTrack> Mp3_Command_PlayRandmomGlobalTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_RepeatPlayCurrentTrack> Mp3_Command_RepeatPlayCurrentTrack;
+typedef Mp3_ActionDescriptor<Mp3_Commands_SetDacInactive> Mp3_Command_SetDacInactive;
+
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetPlaySources, DfMp3_PlaySources> Mp3_Command_GetPlaySources;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetStatus, DfMp3_Status> Mp3_Command_GetStatus;
+// the volume keys change it without a command of ours
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetVolume, uint8_t> Mp3_Command_GetVolume;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetEq, DfMp3_Eq, Mp3_CommandFlags_Cacheable> Mp3_Command_GetEq;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetPlaybackMode, DfMp3_PlaybackMode, Mp3_CommandFlags_Cacheable> Mp3_Command_GetPlaybackMode;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetSoftwareVersion, uint16_t, Mp3_CommandFlags_Cacheable> Mp3_Command_GetSoftwareVersion;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetUsbTrackCount, uint16_t, Mp3_CommandFlags_Cacheable> Mp3_Command_GetUsbTrackCount;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetSdTrackCount, uint16_t, Mp3_CommandFlags_Cacheable> Mp3_Command_GetSdTrackCount;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetFlashTrackCount, uint16_t, Mp3_CommandFlags_Cacheable> Mp3_Command_GetFlashTrackCount;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetUsbCurrentTrack> Mp3_Command_GetUsbCurrentTrack;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetSdCurrentTrack> Mp3_Command_GetSdCurrentTrack;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetFlashCurrentTrack> Mp3_Command_GetFlashCurrentTrack;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetFolderTrackCount, uint16_t, Mp3_CommandFlags_Cacheable> Mp3_Command_GetFolderTrackCount;
+typedef Mp3_QueryDescriptor<Mp3_Commands_GetTotalFolderCount, uint16_t, Mp3_CommandFlags_Cacheable> Mp3_Command_GetTotalFolderCount;
@@ -0,0 +1,180 @@
+/*-------------------------------------------------------------------------
+Mp3DebugLog - deferred debug output, used when DfMiniMp3Debug is defined
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// levels for DfMiniMp3DebugLevel, each includes those below it
+#define DfMp3_DebugLevel_Error 1   // re-entrance
+#define DfMp3_DebugLevel_Notify 2  // invalid notifications
+#define DfMp3_DebugLevel_Packet 3  // every packet in and out
+
+#ifndef DfMiniMp3DebugLevel
+#define DfMiniMp3DebugLevel DfMp3_DebugLevel_Packet
+#endif
+
+// number of events held until printed, more are counted as dropped
+#ifndef DfMiniMp3DebugLogSize
+#define DfMiniMp3DebugLogSize 16
+#endif
+
+enum Mp3_LogEvent
+{
+    Mp3_LogEvent_PacketOut,
+    Mp3_LogEvent_PacketIn,
+    Mp3_LogEvent_InvalidNotification,
+    Mp3_LogEvent_Reentrant,
+};
+
+// Events are only recorded in binary while in a transaction,
+// the sprintf and Stream work is done later by print(), 
+// outside of the transaction, so comms timing is not disturbed
+//
+class Mp3DebugLog
+{
+public:
+    Mp3DebugLog() :
+        _dropped(0),
+        _droppedPrinted(0)
+    {
+    }
+
+    void logPacket(Mp3_LogEvent type, const uint8_t* data, size_t dataSize)
+    {
+        entry_t entry;
+
+        entry.type = type;
+        entry.length = (dataSize < sizeof(entry.data)) ? dataSize : sizeof(entry.data);
+        memcpy(entry.data, data, entry.length);
+        append(entry);
+    }
+
+    void logReply(Mp3_LogEvent type, uint8_t command, uint16_t arg)
+    {
+        entry_t entry;
+
+        entry.type = type;
+        entry.length = 3;
+        entry.data[0] = command;
+        entry.data[1] = (arg >> 8);
+        entry.data[2] = (arg & 0xff);
+        append(entry);
+    }
+
+    void logValue(Mp3_LogEvent type, uint8_t value)
+    {
+        entry_t entry;
+
+        entry.type = type;
+        entry.length = 1;
+        entry.data[0] = value;
+        append(entry);
+    }
+
+    template <class T_STREAM> void print(T_STREAM& out)
+    {
+        entry_t entry;
+
+        while (_log.Dequeue(&entry))
+        {
+            switch (entry.type)
+            {
+            case Mp3_LogEvent_PacketOut:
+                out.print("OUT ");
+                printRawPacket(out, entry.data, entry.length);
+                break;
+
+            case Mp3_LogEvent_PacketIn:
+                out.print("IN ");
+                printRawPacket(out, entry.data, entry.length);
+                break;
+
+            case Mp3_LogEvent_InvalidNotification:
+                out.print("INVALID NOTIFICATION: ");
+                printReply(out, entry);
+                break;
+
+            case Mp3_LogEvent_Reentrant:
+                out.print("Rentrant? _inTransaction ");
+                out.print(entry.data[0]);
+                break;
+            }
+            out.println();
+        }
+
+        uint8_t dropped = _dropped;
+
+        if (dropped != _droppedPrinted)
+        {
+            out.print("LOG DROPPED ");
+            out.println(static_cast<uint8_t>(dropped - _droppedPrinted));
+            _droppedPrinted = dropped;
+        }
+    }
+
+private:
+    struct entry_t
+    {
+        uint8_t type;
+        uint8_t length;
+        uint8_t data[10];
+    };
+
+    ringSimple_t<entry_t, DfMiniMp3DebugLogSize> _log;
+    // a running count only the logging side writes, print() reports 
+    // what it has not yet, so neither side changes what the other does
+    volatile uint8_t _dropped;
+    uint8_t _droppedPrinted;
+
+    void append(const entry_t& entry)
+    {
+        if (!_log.Enqueue(entry))
+        {
+            _dropped = static_cast<uint8_t>(_dropped + 1);
+        }
+    }
+
+    template <class T_STREAM> static void printReply(T_STREAM& out, const entry_t& entry)
+    {
+        char formated[8];
+
+        sprintf(formated, " %02x", entry.data[0]);
+        out.print(formated);
+        sprintf(formated, " %02x%02x", entry.data[1], entry.data[2]);
+        out.print(formated);
+    }
+
+    template <class T_STREAM> static void printRawPacket(T_STREAM& out, const uint8_t* data, size_t dataSize)
+    {
+        char formated[8];
+        const uint8_t* end = data + dataSize;
+
+        while (data < end)
+        {
+            sprintf(formated, " %02x", *data);
+            out.print(formated);
+            data++;
+        }
+    }
+};
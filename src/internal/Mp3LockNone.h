@@ -0,0 +1,62 @@
+/*-------------------------------------------------------------------------
+Mp3LockNone - the default lock policy and the guard used with any policy
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// the default T_LOCK_POLICY of DFMiniMp3, for single threaded use,
+// it compiles away to nothing; include Mp3LockPolicy.h for the others
+class Mp3LockNone
+{
+public:
+    void lock()
+    {
+    }
+
+    void unlock()
+    {
+    }
+};
+
+// holds the lock for the scope it is declared in
+template <class T_LOCK> class Mp3LockGuard
+{
+public:
+    explicit Mp3LockGuard(T_LOCK& lock) :
+        _lock(lock)
+    {
+        _lock.lock();
+    }
+
+    ~Mp3LockGuard()
+    {
+        _lock.unlock();
+    }
+
+private:
+    T_LOCK& _lock;
+
+    Mp3LockGuard(const Mp3LockGuard&);
+    Mp3LockGuard& operator=(const Mp3LockGuard&);
+};
@@ -45,6 +45,7 @@ enum Mp3_Commands
     Mp3_Commands_Start = 0x0d,
     Mp3_Commands_Pause = 0x0e,
     Mp3_Commands_PlayFolderTrack = 0x0f,
+    Mp3_Commands_SetVolumeMute = 0x10, // undocumented use, arg (!mute << 8) | volume 0-31
     Mp3_Commands_RepeatPlayInRoot = 0x11,
     Mp3_Commands_PlayMp3FolderTrack = 0x12,
     Mp3_Commands_PlayAdvertTrack = 0x13,
@@ -87,8 +88,20 @@ enum Mp3_Replies
 
 const uint8_t Mp3_PacketStartCode = 0x7e;
 const uint8_t Mp3_PacketVersion = 0xff;
+const uint8_t Mp3_PacketLength = 0x06;
 const uint8_t Mp3_PacketEndCode = 0xef;
 
+// precomputed packets are kept in flash on platforms that separate it
+#if defined(PROGMEM)
+#define Mp3_ProgMem PROGMEM
+#define Mp3_ProgMemCopy(dest, src, size) memcpy_P((dest), (src), (size))
+#define Mp3_ProgMemReadByte(src) pgm_read_byte(src)
+#else
+#define Mp3_ProgMem
+#define Mp3_ProgMemCopy(dest, src, size) memcpy((dest), (src), (size))
+#define Mp3_ProgMemReadByte(src) (*(src))
+#endif
+
 // 7E FF 06 0F 00 01 01 xx xx EF
 // 0	->	7E is start code
 // 1	->	FF is version
@@ -0,0 +1,55 @@
+/*-------------------------------------------------------------------------
+Mp3SpanTracing - transaction span hooks, used when DfMiniMp3SpanTracer is defined
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// Define DfMiniMp3SpanTracer as the name of a class with these 
+// static methods before including DFMiniMp3.h, when not defined
+// the hooks compile to nothing
+//
+// class MyTracer
+// {
+// public:
+//     static void OnSpanBegin(DfMp3_Span span, uint8_t command);
+//     static void OnSpanEnd(DfMp3_Span span, uint8_t command, uint16_t result);
+//     static void OnSpanInstant(DfMp3_Span span, uint8_t command);
+// };
+// #define DfMiniMp3SpanTracer MyTracer
+//
+// Mp3ChromeTraceSink is one such class for host builds.
+
+#ifdef DfMiniMp3SpanTracer
+
+#define DfMp3_SpanBegin(span, command) DfMiniMp3SpanTracer::OnSpanBegin((span), (command))
+#define DfMp3_SpanEnd(span, command, result) DfMiniMp3SpanTracer::OnSpanEnd((span), (command), (result))
+#define DfMp3_SpanInstant(span, command) DfMiniMp3SpanTracer::OnSpanInstant((span), (command))
+
+#else
+
+#define DfMp3_SpanBegin(span, command) 
+#define DfMp3_SpanEnd(span, command, result) 
+#define DfMp3_SpanInstant(span, command) 
+
+#endif
@@ -0,0 +1,135 @@
+/*-------------------------------------------------------------------------
+ringSimple_t - simple fixed size ring, no heap use, as not all Arduino have stl types available 
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/DFMiniMp3)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/DFMiniMp3 library.
+
+DFMiniMp3 is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+DFMiniMp3 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with DFMiniMp3.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+#pragma once
+
+// C_LENGTH items are stored, one extra slot is used to tell full from empty
+// 
+// Enqueue() and Dequeue() only ever write _back and _front respectively,
+// so a single producer and a single consumer may use it without a lock
+// (an ISR or task and loop() for example), EnqueueOverwrite() may not
+//
+template <class T_ITEM, uint8_t C_LENGTH> class ringSimple_t
+{
+public:
+    ringSimple_t() :
+        _front(0),
+        _back(0)
+    {
+    }
+
+    // fails when full, oldest items are kept
+    bool Enqueue(const T_ITEM& item)
+    {
+        uint8_t newBack = next(_back);
+
+        if (newBack == _front)
+        {
+            return false;
+        }
+        _items[_back] = item;
+        // item must be complete before the consumer can see it
+        __sync_synchronize();
+        _back = newBack;
+        return true;
+    }
+
+    // never fails, when full the oldest item is discarded
+    void EnqueueOverwrite(const T_ITEM& item)
+    {
+        uint8_t newBack = next(_back);
+
+        if (newBack == _front)
+        {
+            _front = next(_front);
+        }
+        _items[_back] = item;
+        _back = newBack;
+    }
+
+    bool Dequeue(T_ITEM* item)
+    {
+        if (_front == _back)
+        {
+            *item = {};
+            return false;
+        }
+
+        __sync_synchronize();
+        *item = _items[_front];
+        // item must be copied before the producer can reuse the slot
+        __sync_synchronize();
+        _front = next(_front);
+        return true;
+    }
+
+    // index zero is the oldest item
+    bool Peek(uint8_t index, T_ITEM* item) const
+    {
+        if (index >= Count())
+        {
+            *item = {};
+            return false;
+        }
+
+        uint16_t slot = static_cast<uint16_t>(_front) + index;
+        if (slot >= c_slots)
+        {
+            slot -= c_slots;
+        }
+        *item = _items[slot];
+        return true;
+    }
+
+    uint8_t Count() const
+    {
+        uint8_t front = _front;
+        uint8_t back = _back;
+
+        return (back >= front) ? (back - front) : (c_slots - front + back);
+    }
+
+    void Clear()
+    {
+        _front = _back;
+    }
+
+private:
+    static const uint16_t c_slots = static_cast<uint16_t>(C_LENGTH) + 1;
+
+    T_ITEM _items[c_slots];
+    volatile uint8_t _front; // location of removing present items
+    volatile uint8_t _back; // location of appending new items
+
+    static uint8_t next(uint8_t index)
+    {
+        index++;
+        if (index >= c_slots)
+        {
+            index = 0;
+        }
+        return index;
+    }
+};